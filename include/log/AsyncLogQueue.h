@@ -0,0 +1,249 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef ASYNCLOGQUEUE_H_INCLUDED__
+#define ASYNCLOGQUEUE_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/LogMessage.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * Selects what an asynchronous log does when its queue is full.
+ */
+enum class LogOverflowPolicy
+{
+  /** The logging thread waits until space is available in the queue. */
+  Block,
+  /** The message being logged is discarded. */
+  DropNewest,
+  /** 
+   * The oldest queued message is discarded to make room for the new one.  
+   * While the background thread is passing the oldest messages to the sink 
+   * their slots cannot be reused, so the new message is discarded instead.
+   */
+  DropOldest
+};
+
+/**
+ * A bounded, lock-free, multi-producer queue of log messages that is drained 
+ * by a single background thread.  Producers copy the message into a 
+ * preallocated slot, so a slow sink never stalls the logging threads (unless 
+ * the queue fills and the Block policy is in use).
+ * 
+ * The queue is a ring of sequenced slots (Vyukov's bounded queue).  Since the 
+ * ring also supports multiple consumers, producers are able to discard the 
+ * oldest message themselves when using the DropOldest policy.
+ * 
+ * The background thread claims up to MAX_BATCH messages at a time and passes 
+ * them to the sink together, so that writers can emit them with one write.
+ */
+class AsyncLogQueue final
+{
+public:
+  /** Receives batches of messages on the background thread. */
+  using Sink = std::function<void(const LogMessage* const*, std::size_t)>;
+
+  /** The largest number of messages passed to the sink in one call. */
+  static const std::size_t MAX_BATCH = 64;
+
+private:
+  struct Slot
+  {
+    std::atomic<std::size_t> sequence;
+    LogLevel level;
+    std::chrono::system_clock::time_point timeStamp;
+    std::string logName;
+    std::string tag;
+    std::string message;
+    LogSource source;
+    std::vector<LogField> fields;
+    // the keys and string values of the fields, which refer into it
+    std::string fieldText;
+  };
+
+  std::vector<Slot> slots;
+  const std::size_t mask;
+  const LogOverflowPolicy policy;
+  Sink sink;
+
+  // producer and consumer positions are kept on separate cache lines
+  std::atomic<std::size_t> enqueuePos;
+  char enqueuePadding[LU_CACHE_LINE_SIZE];
+  std::atomic<std::size_t> dequeuePos;
+  char dequeuePadding[LU_CACHE_LINE_SIZE];
+
+  std::atomic<std::uint64_t> droppedNewest;
+  std::atomic<std::uint64_t> droppedOldest;
+
+  std::mutex mutex;
+  std::condition_variable wakeCondition;
+  std::condition_variable flushCondition;
+  std::condition_variable spaceCondition;
+  std::atomic<bool> sleeping;
+  std::atomic<unsigned> blockedProducers;
+  bool stopping;
+  bool stopped;
+  std::uint64_t flushRequested;
+  // the dequeue position the background thread had passed after its last 
+  // drain, every message before it has been passed to the sink or discarded
+  std::size_t flushedPos;
+  std::thread worker;
+
+public:
+  // constructors
+  AsyncLogQueue() = delete;
+  AsyncLogQueue(const AsyncLogQueue&) = delete;
+
+  /**
+   * Creates the queue and starts the background thread.
+   * \param capacity The number of messages that may be queued.  Rounded up 
+   * to a power of two.
+   * \param policy The behavior when the queue is full.
+   * \param sink Called on the background thread for every batch of 
+   * messages.
+   */
+  AsyncLogQueue(std::size_t capacity, LogOverflowPolicy policy, Sink sink);
+
+  // destructor
+  ~AsyncLogQueue();
+
+  // operators
+  AsyncLogQueue& operator=(const AsyncLogQueue&) = delete;
+
+  /**
+   * Queues a message.  Safe to call from any number of threads.
+   * \return false if the message was discarded because the queue was full.
+   */
+  bool push(LogLevel level, std::chrono::system_clock::time_point timeStamp,
+    StringRef logName, StringRef tag, StringRef msg, 
+    const LogSource& source, LogFields fields);
+
+  /**
+   * Blocks until every message pushed before the call has been passed to the 
+   * sink or discarded.  Must not be called from the sink.
+   */
+  void flush();
+
+  /**
+   * Drains all queued messages into the sink and stops the background 
+   * thread.  Messages must not be pushed after shutdown.
+   */
+  void shutdown();
+
+  /**
+   * Returns the number of slots in the queue.
+   */
+  std::size_t getCapacity() const;
+
+  /**
+   * Returns the overflow policy of the queue.
+   */
+  LogOverflowPolicy getPolicy() const;
+
+  /**
+   * Returns the number of new messages discarded because the queue was full.
+   */
+  std::uint64_t getDroppedNewest() const;
+
+  /**
+   * Returns the number of queued messages discarded to make room for newer 
+   * messages.
+   */
+  std::uint64_t getDroppedOldest() const;
+
+private:
+  /**
+   * Attempts to claim and fill a slot.  Returns false if the queue is full.
+   */
+  bool tryPush(LogLevel level, std::chrono::system_clock::time_point timeStamp,
+    StringRef logName, StringRef tag, StringRef msg, 
+    const LogSource& source, LogFields fields);
+
+  /**
+   * Copies the fields and the strings they refer to into the slot.
+   */
+  static void copyFields(Slot& slot, LogFields fields);
+
+  /**
+   * Attempts to claim the oldest filled slot.  The slot must be returned 
+   * with release() once it has been read.
+   */
+  Slot* tryAcquire(std::size_t& pos);
+
+  /**
+   * Returns a slot claimed by tryAcquire() to the producers.
+   */
+  void release(Slot* slot, std::size_t pos);
+
+  /**
+   * Discards the oldest message to make room for a push, if that frees the 
+   * slot the push needs.  Used by the DropOldest policy.
+   * \return false if nothing was discarded.
+   */
+  bool discardOldest();
+
+  /**
+   * Returns true if the slot at the head of the queue holds a message.
+   */
+  bool hasPending() const;
+
+  /**
+   * Returns true if the slot at the tail of the queue is free.
+   */
+  bool hasSpace() const;
+
+  /**
+   * Waits for the background thread to free a slot, used by the Block policy 
+   * when the queue is full.
+   */
+  void waitForSpace();
+
+  /**
+   * Wakes the background thread if it is waiting for messages.
+   */
+  void wake();
+
+  /**
+   * Passes all queued messages to the sink, in batches.
+   */
+  void drain();
+
+  /**
+   * The loop run by the background thread.
+   */
+  void run();
+};
+
+}
+
+#endif
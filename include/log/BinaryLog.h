@@ -0,0 +1,538 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef BINARYLOG_H_INCLUDED__
+#define BINARYLOG_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/LogClock.h"
+#include "log/LogMessage.h"
+#include "log/LogFormat.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * Identifies how an argument of a binary log record is encoded.
+ */
+enum class BinaryArgType : std::uint8_t
+{
+  Bool,
+  Char,
+  Int32,
+  UInt32,
+  Int64,
+  UInt64,
+  Double,
+  String,
+  Pointer
+};
+
+/**
+ * Describes one call site of a binary log: the level, tag, and format string 
+ * used there, and the types of its arguments.  Sites are registered once per 
+ * process and never destroyed.
+ */
+struct BinaryLogSite final
+{
+  /** The identifier written into each record. */
+  std::uint32_t id;
+  /** The level of messages logged at the site. */
+  LogLevel level;
+  /** The tag passed by the first caller, compared by address. */
+  StringRef callerTag;
+  /** A copy of the tag. */
+  std::string tag;
+  /** The LU_FMT format string. */
+  const char* format;
+  /** The type of each argument. */
+  std::vector<BinaryArgType> argTypes;
+};
+
+/**
+ * A per-thread single-producer, single-consumer byte ring that holds encoded 
+ * records until the background thread of the log writes them out.  Records 
+ * are always stored contiguously.
+ */
+class BinaryLogBuffer final
+{
+private:
+  std::vector<char> storage;
+  const std::uint64_t logId;
+  std::atomic<std::size_t> producerPos;
+  std::size_t endOfRecordedSpace;
+  std::size_t minFreeSpace;
+  char padding[LU_CACHE_LINE_SIZE];
+  std::atomic<std::size_t> consumerPos;
+  std::atomic<bool> retired;
+
+public:
+  // constructors
+  BinaryLogBuffer(std::size_t capacity, std::uint64_t logId);
+  BinaryLogBuffer(const BinaryLogBuffer&) = delete;
+  // operators
+  BinaryLogBuffer& operator=(const BinaryLogBuffer&) = delete;
+
+  /**
+   * Returns the identifier of the log that owns the buffer.
+   */
+  std::uint64_t getLogId() const;
+
+  /**
+   * Returns space for a record of the given size, waiting for the consumer 
+   * if necessary.  Returns null if the record can never fit.
+   */
+  char* reserve(std::size_t size);
+
+  /**
+   * Makes a reserved record visible to the consumer.
+   */
+  void commit(std::size_t size);
+
+  /**
+   * Returns the next contiguous block of committed bytes, and its size.
+   */
+  const char* peek(std::size_t& size);
+
+  /**
+   * Releases bytes returned by peek() back to the producer.
+   */
+  void consume(std::size_t size);
+
+  /**
+   * Marks the buffer as abandoned by its thread.
+   */
+  void retire();
+
+  /**
+   * Returns true if the producing thread has exited.
+   */
+  bool isRetired() const;
+
+private:
+  /**
+   * Waits for enough free space when the cached free space is too small.
+   */
+  char* reserveSlow(std::size_t size);
+};
+
+/**
+ * A log for the highest-rate call sites.  A call records only a call site 
+ * identifier, a timestamp, and the raw bytes of its arguments into a buffer 
+ * owned by the calling thread.  No formatting or locking happens on the 
+ * calling thread.  A background thread copies the buffers into a binary 
+ * stream, along with a description of each call site the first time it 
+ * appears.  BinaryLogDecoder turns the stream back into LogMessages.
+ * 
+ * Call sites are identified by their LU_FMT format string, argument types, 
+ * level, and tag.  Each call site caches its registration, and the cache 
+ * only hits when the level and the address of the tag match the first call.  
+ * Calls with another level or tag, such as a tag built in a temporary 
+ * string, take a slower path that looks up the site under a lock.  Use 
+ * string literals for tags.
+ * 
+ * Records of one thread appear in the stream in order, but records of 
+ * different threads are only ordered within each batch written by the 
+ * background thread.
+ */
+class BinaryLog final
+{
+private:
+  /** The buffer most recently used by a thread. */
+  struct ThreadBufferCache
+  {
+    std::uint64_t logId;
+    BinaryLogBuffer* buffer;
+  };
+
+  static thread_local ThreadBufferCache threadBufferCache;
+
+  std::string logName;
+  std::atomic<LogLevel> outputLevel;
+  std::ostream& output;
+  const std::size_t bufferSize;
+  const std::uint64_t logId;
+
+  std::mutex mutex;
+  std::condition_variable wakeCondition;
+  std::condition_variable flushCondition;
+  std::vector<StrongPtr<BinaryLogBuffer>> buffers;
+  std::size_t sitesWritten;
+  std::uint64_t flushRequested;
+  std::uint64_t flushCompleted;
+  bool stopping;
+  std::atomic<std::uint64_t> dropped;
+  std::thread worker;
+
+public:
+  // constructors
+  BinaryLog() = delete;
+  BinaryLog(const BinaryLog&) = delete;
+
+  /**
+   * Creates the log and starts its background thread.
+   * \param logName The name of the log, stored in the stream.
+   * \param output The stream receiving the binary log.  Must outlive the log.
+   * \param bufferSize The size of each thread's buffer in bytes.
+   * \param outputLevel Messages below this level are ignored.
+   */
+  BinaryLog(const std::string& logName, std::ostream& output,
+    std::size_t bufferSize = 1 << 20, LogLevel outputLevel = LogLevel::All);
+
+  // destructor
+  ~BinaryLog();
+
+  // operators
+  BinaryLog& operator=(const BinaryLog&) = delete;
+
+  /**
+   * Retrieves the name of this log.
+   */
+  const std::string& getName() const;
+
+  /**
+   * Sets the output level of this log.
+   */
+  void setLevel(LogLevel outputLevel);
+
+  /**
+   * Retrieves the output level of this log.
+   */
+  LogLevel getLevel() const;
+
+  /**
+   * Returns true if messages at the provided level will be recorded.
+   */
+  bool isActive(LogLevel level) const;
+
+  /**
+   * Records a message.  The format string must be created with LU_FMT, and 
+   * each argument must be a bool, character, integer, floating point number, 
+   * string, or pointer.  Strings are copied into the record.
+   */
+  template<typename Format, typename ...Args>
+  typename std::enable_if<IsFormatString<Format>::value>::type log(
+    LogLevel level, StringRef tag, Format fmt, const Args&... args);
+
+  /**
+   * Blocks until everything recorded before the call has been written to the 
+   * stream, and flushes the stream.
+   */
+  void flush();
+
+  /**
+   * Returns the number of records that were too large for a thread buffer.
+   */
+  std::uint64_t getDroppedCount() const;
+
+  /**
+   * Returns the site for a format string, registering it if needed.  Used 
+   * by log().
+   */
+  static const BinaryLogSite* findSite(const char* format, LogLevel level, 
+    StringRef tag, const BinaryArgType* argTypes, std::size_t argCount);
+
+private:
+  /**
+   * Returns the calling thread's buffer for this log.
+   */
+  BinaryLogBuffer* getThreadBuffer();
+
+  /**
+   * Finds or creates the calling thread's buffer when it is not cached.
+   */
+  BinaryLogBuffer* findThreadBuffer();
+
+  /**
+   * The loop run by the background thread.
+   */
+  void run();
+
+  /**
+   * Writes out all pending records.  Returns true if anything was written.
+   */
+  bool drain();
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+namespace detail
+{
+
+/** Marks an entry in a binary log stream. */
+enum class BinaryEntry : std::uint8_t
+{
+  Site = 1,
+  Record = 2
+};
+
+/** The size of the fixed part of a record: entry, site, and timestamp. */
+static const std::size_t BINARY_RECORD_HEADER_SIZE = 1 + 4 + 8;
+
+/**
+ * Describes how an argument type is stored in a binary record.
+ */
+template<typename T, typename Enable = void>
+struct BinaryArg;
+
+template<typename T>
+void writeBinary(char*& out, const T& value)
+{
+  std::memcpy(out, &value, sizeof(T));
+  out += sizeof(T);
+}
+
+/** Numbers are stored as their raw bytes. */
+template<typename T, BinaryArgType Type, typename Stored>
+struct BinaryArithmeticArg
+{
+  static const BinaryArgType type = Type;
+
+  static std::size_t size(T value)
+  {
+    LU_UNUSED(value);
+    return sizeof(Stored);
+  }
+
+  static void write(char*& out, T value)
+  {
+    writeBinary(out, static_cast<Stored>(value));
+  }
+};
+
+template<>
+struct BinaryArg<bool>
+  : BinaryArithmeticArg<bool, BinaryArgType::Bool, std::uint8_t>
+{
+};
+
+template<>
+struct BinaryArg<char>
+  : BinaryArithmeticArg<char, BinaryArgType::Char, char>
+{
+};
+
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && 
+  std::is_signed<T>::value && sizeof(T) <= 4 && 
+  !std::is_same<T, char>::value>::type>
+  : BinaryArithmeticArg<T, BinaryArgType::Int32, std::int32_t>
+{
+};
+
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && 
+  std::is_signed<T>::value && (sizeof(T) > 4)>::type>
+  : BinaryArithmeticArg<T, BinaryArgType::Int64, std::int64_t>
+{
+};
+
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && 
+  std::is_unsigned<T>::value && sizeof(T) <= 4 && 
+  !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>
+  : BinaryArithmeticArg<T, BinaryArgType::UInt32, std::uint32_t>
+{
+};
+
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && 
+  std::is_unsigned<T>::value && (sizeof(T) > 4)>::type>
+  : BinaryArithmeticArg<T, BinaryArgType::UInt64, std::uint64_t>
+{
+};
+
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<
+  std::is_floating_point<T>::value>::type>
+  : BinaryArithmeticArg<T, BinaryArgType::Double, double>
+{
+};
+
+/** Strings are stored as a 32 bit length followed by the characters. */
+template<>
+struct BinaryArg<StringRef>
+{
+  static const BinaryArgType type = BinaryArgType::String;
+
+  static std::size_t size(StringRef value)
+  {
+    return sizeof(std::uint32_t) + value.size();
+  }
+
+  static void write(char*& out, StringRef value)
+  {
+    writeBinary(out, static_cast<std::uint32_t>(value.size()));
+    std::memcpy(out, value.data(), value.size());
+    out += value.size();
+  }
+};
+
+template<>
+struct BinaryArg<std::string>
+  : BinaryArg<StringRef>
+{
+};
+
+template<>
+struct BinaryArg<const char*>
+  : BinaryArg<StringRef>
+{
+};
+
+template<>
+struct BinaryArg<char*>
+  : BinaryArg<StringRef>
+{
+};
+
+/** Other pointers are stored as an address. */
+template<typename T>
+struct BinaryArg<T*, typename std::enable_if<
+  !std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+  : BinaryArithmeticArg<const void*, BinaryArgType::Pointer, std::uint64_t>
+{
+  static void write(char*& out, const void* value)
+  {
+    writeBinary(out, static_cast<std::uint64_t>(
+      reinterpret_cast<std::uintptr_t>(value)));
+  }
+};
+
+template<typename T>
+using BinaryArgFor = BinaryArg<typename std::decay<T>::type>;
+
+inline std::size_t binaryArgsSize()
+{
+  return 0;
+}
+
+template<typename T, typename ...Rest>
+std::size_t binaryArgsSize(const T& value, const Rest&... rest)
+{
+  return BinaryArgFor<T>::size(value) + binaryArgsSize(rest...);
+}
+
+inline void writeBinaryArgs(char*& out)
+{
+  LU_UNUSED(out);
+}
+
+template<typename T, typename ...Rest>
+void writeBinaryArgs(char*& out, const T& value, const Rest&... rest)
+{
+  BinaryArgFor<T>::write(out, value);
+  writeBinaryArgs(out, rest...);
+}
+
+}
+
+inline char* BinaryLogBuffer::reserve(std::size_t size)
+{
+  // strictly less, so the producer never catches up to the consumer
+  if (size < minFreeSpace)
+  {
+    return storage.data() + producerPos.load(std::memory_order_relaxed);
+  }
+  return reserveSlow(size);
+}
+
+inline void BinaryLogBuffer::commit(std::size_t size)
+{
+  auto pos = producerPos.load(std::memory_order_relaxed) + size;
+  minFreeSpace -= size;
+  producerPos.store(pos, std::memory_order_release);
+}
+
+inline BinaryLogBuffer* BinaryLog::getThreadBuffer()
+{
+  if (threadBufferCache.logId == logId)
+  {
+    return threadBufferCache.buffer;
+  }
+  return findThreadBuffer();
+}
+
+template<typename Format, typename ...Args>
+typename std::enable_if<IsFormatString<Format>::value>::type BinaryLog::log(
+  LogLevel level, StringRef tag, Format fmt, const Args&... args)
+{
+  static_assert(
+    detail::countFormatArguments(Format::data()) == sizeof...(Args),
+    "Number of format arguments does not match the format string");
+  LU_UNUSED(fmt);
+
+  if (!isActive(level))
+  {
+    return;
+  }
+
+  // one cache per call site, since each LU_FMT has a unique type
+  static std::atomic<const BinaryLogSite*> cachedSite(nullptr);
+  const BinaryLogSite* site = cachedSite.load(std::memory_order_acquire);
+  if (!site || site->level != level || 
+    site->callerTag.data() != tag.data() || 
+    site->callerTag.size() != tag.size())
+  {
+    // the extra element allows for calls without arguments
+    static const BinaryArgType argTypes[] = {
+      detail::BinaryArgFor<Args>::type..., BinaryArgType::Bool
+    };
+    site = findSite(Format::data(), level, tag, argTypes, sizeof...(Args));
+    cachedSite.store(site, std::memory_order_release);
+  }
+
+  auto timeStamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    LogClock::now().time_since_epoch()).count();
+  std::size_t size = detail::BINARY_RECORD_HEADER_SIZE + 
+    detail::binaryArgsSize(args...);
+
+  BinaryLogBuffer* buffer = getThreadBuffer();
+  char* out = buffer->reserve(size);
+  if (!out)
+  {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  char* pos = out;
+  detail::writeBinary(pos, detail::BinaryEntry::Record);
+  detail::writeBinary(pos, site->id);
+  detail::writeBinary(pos, static_cast<std::int64_t>(timeStamp));
+  detail::writeBinaryArgs(pos, args...);
+  assert(static_cast<std::size_t>(pos - out) == size);
+  buffer->commit(size);
+}
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef BINARYLOGDECODER_H_INCLUDED__
+#define BINARYLOGDECODER_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/BinaryLog.h"
+#include "log/LogWriter.h"
+#include <functional>
+#include <istream>
+#include <string>
+#include <unordered_map>
+
+namespace util
+{
+
+/**
+ * Reads a stream written by BinaryLog and turns the records back into log 
+ * messages, doing the formatting that was deferred when they were logged.  
+ * The call site descriptions in the stream make it self-contained, so it can 
+ * be decoded by a different process than the one that wrote it.  The stream 
+ * must be decoded on a machine with the same endianness.
+ */
+class BinaryLogDecoder final
+{
+public:
+  /** Receives each decoded message. */
+  using Sink = std::function<void(const LogMessage&)>;
+
+private:
+  struct Site
+  {
+    LogLevel level;
+    std::string tag;
+    std::string format;
+    std::vector<BinaryArgType> argTypes;
+  };
+
+  std::unordered_map<std::uint32_t, Site> sites;
+  std::string logName;
+  std::string message;
+  std::string error;
+
+public:
+  // constructors
+  BinaryLogDecoder() = default;
+  BinaryLogDecoder(const BinaryLogDecoder&) = delete;
+  // operators
+  BinaryLogDecoder& operator=(const BinaryLogDecoder&) = delete;
+
+  /**
+   * Decodes every record in a stream.
+   * \param in The stream to read, opened in binary mode.
+   * \param sink Called with each message in stream order.
+   * \return false if the stream is not a binary log or is damaged.  Messages 
+   * before the damage have already been passed to the sink.
+   */
+  bool decode(std::istream& in, const Sink& sink);
+
+  /**
+   * Decodes every record in a stream into a writer, which formats and 
+   * outputs them as usual.
+   */
+  bool decode(std::istream& in, LogWriter& writer);
+
+  /**
+   * Returns a description of the last decoding error.
+   */
+  const std::string& getError() const;
+
+private:
+  /**
+   * Reads a site description entry.
+   */
+  bool readSite(std::istream& in);
+
+  /**
+   * Reads a record and formats its message.
+   */
+  bool readRecord(std::istream& in, const Sink& sink);
+
+  /**
+   * Reads one argument and appends it to the message.
+   */
+  bool appendArg(std::istream& in, BinaryArgType type);
+
+  /**
+   * Records an error and returns false.
+   */
+  bool fail(const std::string& reason);
+};
+
+}
+
+#endif
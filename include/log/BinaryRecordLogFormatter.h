@@ -0,0 +1,78 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINARYRECORDLOGFORMATTER_H_INCLUDED__
+#define BINARYRECORDLOGFORMATTER_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/ILogFormatter.h"
+#include <string>
+
+namespace util
+{
+
+/**
+ * Formats each message as a compact, length prefixed binary record, so that 
+ * a reader can skip records without parsing them.  Numbers are stored in the 
+ * byte order of the host, like BinaryLog, and strings as a u32 length 
+ * followed by their bytes.  A record is laid out as:
+ * 
+ *     u32    size of the rest of the record
+ *     i64    time stamp, nanoseconds since the epoch
+ *     u8     level
+ *     string log name
+ *     string tag
+ *     string message
+ *     string source file, empty if unknown
+ *     u32    source line, 0 if unknown
+ *     string source function, empty if unknown
+ *     u16    field count
+ *     fields
+ * 
+ * Each field is its key as a string, then a u8 LogFieldType and the value: 
+ * a u8 for Bool, an i64 for Int, a u64 for UInt, a double for Double and a 
+ * string for String.  At most 65535 fields are written per message.
+ * 
+ * Records are written back to back, so the terminator is empty.  Writers 
+ * using this formatter should write to a file or stream opened in binary 
+ * mode.  Thread safe.
+ */
+class BinaryRecordLogFormatter final
+  : public ILogFormatter
+{
+public:
+  // constructors
+  BinaryRecordLogFormatter() = default;
+  BinaryRecordLogFormatter(const BinaryRecordLogFormatter&) = default;
+
+  // operators
+  BinaryRecordLogFormatter& operator=(const BinaryRecordLogFormatter&) = 
+    default;
+
+  virtual void append(const LogMessage& msg, std::string& out) override;
+
+  virtual StringRef getTerminator() const override;
+};
+
+}
+
+#endif
@@ -25,32 +25,96 @@
 #define FILELOGWRITER_H_INCLUDED__
 
 #include "prereqs.h"
+#include "log/LogArchiver.h"
 #include "log/LogWriter.h"
+#include "log/MappedLogFile.h"
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace util
 {
 
 /**
- * A log writer that directs its output to a file.  Not thread safe.
+ * Selects how a FileLogWriter writes to its file.
+ */
+enum class FileLogMode
+{
+  /** Output is written through a file stream, flushed once per batch. */
+  Buffered,
+  /** Output is copied into a preallocated, memory mapped file. */
+  Mapped
+};
+
+/**
+ * Controls when a FileLogWriter moves its file aside and starts a new one.  
+ * A zero value disables the corresponding limit.
+ */
+struct FileLogRotation
+{
+  /** Rotate once the file holds at least this many bytes. */
+  std::uint64_t maxSize;
+  /** Rotate once the file has been written for this long. */
+  std::chrono::seconds interval;
+  /** The number of rotated files to keep, the oldest are deleted. */
+  std::size_t maxFiles;
+  /** Compress rotated files, see LogArchiver. */
+  bool compress;
+};
+
+/**
+ * A log writer that directs its output to a file.  In buffered mode the 
+ * writer is not thread safe.  In mapped mode output may be called from 
+ * several threads at once, see MappedLogFile.
+ * 
+ * The writer can rotate its file by size and by time.  The current file is 
+ * renamed with a timestamp suffix (e.g. "app.log.20140301-120000") and a new 
+ * file is opened under the original name.  Rotated files are handed to a 
+ * LogArchiver, which compresses and prunes them in the background, along 
+ * with the files rotated by earlier runs.  In mapped mode the new file is 
+ * published with Rcu, so appends in progress finish in the old file and none 
+ * are lost or split between files.
  */
 class FileLogWriter final
   : public LogWriter
 {
 private:
+  struct RetiredFile
+  {
+    MappedLogFile* file;
+    std::string segment;
+    std::uint64_t gracePeriod;
+  };
+
+  std::string filename;
   std::ofstream file;
+  std::uint64_t fileSize;
+  std::atomic<MappedLogFile*> mapped;
+  std::vector<RetiredFile> retired;
+  std::atomic<bool> hasRetired;
+  FileLogRotation rotation;
+  std::atomic<std::chrono::system_clock::rep> rotateTime;
+  std::unique_ptr<LogArchiver> archiver;
+  std::mutex rotateMutex;
 
 public:
   // constructors
-  FileLogWriter() = default;
+  FileLogWriter();
   FileLogWriter(const FileLogWriter&) = delete;
 
   /**
    * Creates a writer opening a file immediately.  Same behavior as open().  
    * Check isOpen() before using the file.
    */
-  explicit FileLogWriter(const std::string& filename, bool append = false);
+  explicit FileLogWriter(const std::string& filename, bool append = false, 
+    FileLogMode mode = FileLogMode::Buffered);
+
+  // destructor
+  ~FileLogWriter();
   
   // operators
   FileLogWriter& operator=(const FileLogWriter&) = delete;
@@ -61,12 +125,17 @@ public:
    * \param filename The path of the file to open.
    * \param append If true, appends to an existing file.  Otherwise replaces 
    * the existing file.
+   * \param mode How output is written to the file.  Mapped mode is only 
+   * available on Linux.
    * \return True if the file was opened.
    */
-  bool open(const std::string& filename, bool append = false);
+  bool open(const std::string& filename, bool append = false, 
+    FileLogMode mode = FileLogMode::Buffered);
 
   /**
-   * Closes the file, if one is open.
+   * Closes the file, if one is open.  A mapped file is truncated to the 
+   * length that was written.  Must not be called while messages are being 
+   * written.
    */
   void close();
 
@@ -75,8 +144,79 @@ public:
    */
   bool isOpen() const;
 
+  /**
+   * Returns the mode of the open file.
+   */
+  FileLogMode getMode() const;
+
+  /**
+   * Sets when the file is rotated.  Must not be called while messages are 
+   * being written.  Rotation is disabled by default.
+   */
+  void setRotation(const FileLogRotation& rotation);
+
+  /**
+   * Returns the rotation settings.
+   */
+  const FileLogRotation& getRotation() const;
+
+  /**
+   * Rotates the file immediately.  In buffered mode must not be called while 
+   * messages are being written.
+   * \return true if the file was rotated.
+   */
+  bool rotate();
+
 protected:
-  virtual void output(const std::string& msg) override;
+  virtual void output(StringRef lines) override;
+
+private:
+  /**
+   * Returns the number of bytes in the current file.
+   */
+  std::uint64_t getFileSize() const;
+
+  /**
+   * Returns true if the size or interval limit has been reached.  The 
+   * interval is measured with LogClock, which is cheap to read on every 
+   * batch.
+   */
+  bool isRotationDue(std::uint64_t size) const;
+
+  /**
+   * Rotates the file.  The rotate mutex must be held.
+   */
+  bool rotateLocked();
+
+  /**
+   * Returns an unused name for the file being rotated.
+   */
+  std::string getSegmentName() const;
+
+  /**
+   * Schedules the next interval based rotation.
+   */
+  void resetRotateTime();
+
+  /**
+   * Replaces the archiver with one for the current file and rotation, which 
+   * prunes the files rotated by earlier runs.  Only done when files are 
+   * limited, otherwise the archiver is created on the first rotation.  The 
+   * rotate mutex must be held.
+   */
+  void startArchiver();
+
+  /**
+   * Passes a rotated file to the archiver, creating it if needed.  The 
+   * rotate mutex must be held.
+   */
+  void archive(const std::string& segment);
+
+  /**
+   * Closes and archives the retired mapped files that are no longer in use, 
+   * or all of them.  The rotate mutex must be held.
+   */
+  void reclaim(bool all);
 };
 
 }
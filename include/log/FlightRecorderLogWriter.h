@@ -0,0 +1,247 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef FLIGHTRECORDERLOGWRITER_H_INCLUDED__
+#define FLIGHTRECORDERLOGWRITER_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/LogWriter.h"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * One message kept by a flight recorder, unformatted.  The names and the 
+ * message are truncated to fit the record.
+ */
+struct FlightRecord
+{
+  /** The space for the log name, tag, and message. */
+  static const std::size_t TEXT_SIZE = 232;
+
+  std::int64_t timeStamp;
+  const char* file;
+  const char* function;
+  std::uint32_t line;
+  LogLevel level;
+  std::uint8_t logNameSize;
+  std::uint8_t tagSize;
+  std::uint8_t messageSize;
+  char text[TEXT_SIZE];
+};
+
+/**
+ * The records of one thread.  Only the owning thread writes to the ring, and 
+ * it never waits: while a dump is reading the ring, new messages of the 
+ * thread are not recorded.
+ */
+struct FlightRing
+{
+  const std::uint64_t recorderId;
+  std::vector<FlightRecord> records;
+  /** The number of records ever written. */
+  std::atomic<std::uint64_t> count;
+  std::atomic<bool> writing;
+  std::atomic<bool> dumping;
+  std::atomic<bool> retired;
+  /** The number of records already dumped, guarded by the dump mutex. */
+  std::uint64_t dumped;
+
+  FlightRing(std::uint64_t recorderId, std::size_t capacity);
+};
+
+/**
+ * A writer that keeps the most recent messages of each thread in memory 
+ * instead of writing them, and dumps them to a file when something goes 
+ * wrong.  Recording a message copies it into a fixed-size record in a ring 
+ * owned by the calling thread, without formatting it, taking a lock, or 
+ * allocating, so the recorder can be left on at all levels in production.  
+ * For it to see verbose messages the log itself must be at the verbose 
+ * level, with the other writers of the log set to the levels they should 
+ * output.
+ * 
+ * The rings are dumped, oldest message first, when dump() is called, when a 
+ * message at or above the dump level is written, and, once 
+ * installSignalHandlers() has been called, when the process receives a 
+ * fatal signal.  Each dump only writes the messages that were not in a 
+ * previous dump.  Normal dumps use the formatter of the writer; dumps from a 
+ * signal handler use a fixed async-signal-safe format instead.
+ * 
+ * Rings of threads that exit are kept, up to MAX_RETIRED_RINGS, so their 
+ * history is still available.  In asynchronous mode every message is 
+ * recorded by the background thread of the log, into a single ring.  Thread 
+ * safe, requires a thread-safe formatter.
+ */
+class FlightRecorderLogWriter final
+  : public LogWriter
+{
+public:
+  /** The number of rings of exited threads that are kept. */
+  static const std::size_t MAX_RETIRED_RINGS = 16;
+
+private:
+  /** The ring most recently used by a thread. */
+  struct ThreadRingCache
+  {
+    std::uint64_t recorderId;
+    FlightRing* ring;
+  };
+
+  static thread_local ThreadRingCache threadRingCache;
+
+  const std::uint64_t recorderId;
+  const std::size_t recordsPerThread;
+  std::atomic<LogLevel> dumpLevel;
+  std::FILE* file;
+  /** The descriptor of the file, for writing from a signal handler. */
+  int fd;
+  std::mutex ringMutex;
+  /** 
+   * Set while the ring list is being changed, so that a signal handler can 
+   * tell whether it may read the list without waiting for the mutex.
+   */
+  std::atomic<bool> ringsChanging;
+  std::vector<StrongPtr<FlightRing>> rings;
+  std::mutex dumpMutex;
+
+public:
+  // constructors
+  FlightRecorderLogWriter() = delete;
+  FlightRecorderLogWriter(const FlightRecorderLogWriter&) = delete;
+
+  /**
+   * Creates a recorder.  The dump file is opened for appending right away, 
+   * so that it can be written from a signal handler.
+   * \param filename The file dumps are appended to.
+   * \param recordsPerThread The number of messages kept for each thread.
+   * \param dumpLevel Writing a message at or above this level dumps the 
+   * rings, LogLevel::None disables it.
+   */
+  explicit FlightRecorderLogWriter(const std::string& filename, 
+    std::size_t recordsPerThread = 1024, 
+    LogLevel dumpLevel = LogLevel::Error);
+
+  // destructor
+  ~FlightRecorderLogWriter();
+
+  // operators
+  FlightRecorderLogWriter& operator=(const FlightRecorderLogWriter&) = 
+    delete;
+
+  /**
+   * Returns true if the dump file was opened.
+   */
+  bool isOpen() const;
+
+  /**
+   * Sets the level that triggers a dump.
+   */
+  void setDumpLevel(LogLevel level);
+
+  /**
+   * Returns the level that triggers a dump.
+   */
+  LogLevel getDumpLevel() const;
+
+  /**
+   * Writes the messages recorded since the previous dump to the file.
+   * \return The number of messages written.
+   */
+  std::size_t dump();
+
+  /**
+   * Installs handlers for SIGSEGV, SIGBUS, SIGFPE, SIGILL, and SIGABRT that 
+   * dump every recorder before the signal is handled as it would have been 
+   * without them.  Call once, after any other handlers for these signals 
+   * are installed, and before other threads start recording.
+   * 
+   * On POSIX systems the handlers run on an alternate signal stack, which is 
+   * set up for the calling thread and for every thread that records a 
+   * message afterwards, so that a crash caused by a stack overflow is still 
+   * dumped.  A thread keeps a stack the application already set up.  On 
+   * Windows a stack overflow is not a signal and is not dumped.
+   */
+  static void installSignalHandlers();
+
+  using LogWriter::write;
+
+  /**
+   * Does nothing, messages are recorded unformatted.
+   */
+  virtual void prepare(LogFormatCache& cache) override;
+
+  virtual void write(LogFormatCache& cache) override;
+
+protected:
+  virtual void output(StringRef lines) override;
+
+private:
+  /**
+   * Copies a message into the calling thread's ring.
+   */
+  void record(const LogMessage& msg);
+
+  /**
+   * Returns the calling thread's ring.
+   */
+  FlightRing* getThreadRing();
+
+  /**
+   * Finds or creates the calling thread's ring when it is not cached.
+   */
+  FlightRing* findThreadRing();
+
+  /**
+   * Dumps the recorder from a signal handler.  Only async-signal-safe 
+   * functions are used, and rings are read even if their thread does not 
+   * finish writing in time.  Nothing is dumped if the ring list is being 
+   * changed.
+   */
+  void dumpFromSignal();
+
+  /**
+   * The handler installed by installSignalHandlers().
+   */
+  static void handleSignal(int signal);
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline FlightRing* FlightRecorderLogWriter::getThreadRing()
+{
+  if (threadRingCache.recorderId == recorderId)
+  {
+    return threadRingCache.ring;
+  }
+  return findThreadRing();
+}
+
+}
+
+#endif
@@ -26,12 +26,15 @@
 
 #include "prereqs.h"
 #include "log/LogMessage.h"
+#include <string>
 
 namespace util
 {
 
 /**
- * The interface providing formatting customization of log messages.
+ * The interface providing formatting customization of log messages.  
+ * Implementations provide append(), which writers use so that no string is 
+ * created for every message.
  */
 class ILogFormatter
 {
@@ -39,11 +42,39 @@ public:
   virtual ~ILogFormatter() = default;
 
   /**
-   * Formats a log message into a single string.
+   * Formats a log message into a single string, using append().
    */
-  virtual std::string format(const LogMessage& msg) = 0;
+  std::string format(const LogMessage& msg);
+
+  /**
+   * Appends a formatted log message to a string.
+   */
+  virtual void append(const LogMessage& msg, std::string& out) = 0;
+
+  /**
+   * Returns the text that writers put after each formatted message.  A 
+   * newline by default, binary formats whose records delimit themselves 
+   * return an empty string.
+   */
+  virtual StringRef getTerminator() const;
 };
 
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline std::string ILogFormatter::format(const LogMessage& msg)
+{
+  std::string result;
+  append(msg, result);
+  return result;
+}
+
+inline StringRef ILogFormatter::getTerminator() const
+{
+  return "\n";
+}
+
 using StrongLogFormatterPtr = StrongPtr<ILogFormatter>;
 using WeakLogFormatterPtr = WeakPtr<ILogFormatter>;
 
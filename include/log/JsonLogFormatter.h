@@ -0,0 +1,68 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef JSONLOGFORMATTER_H_INCLUDED__
+#define JSONLOGFORMATTER_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/ILogFormatter.h"
+#include <string>
+
+namespace util
+{
+
+/**
+ * Formats each message as a single line JSON object (newline delimited 
+ * JSON), for example:
+ * 
+ *     {"ts":1414000000123456789,"level":"Info","log":"app","tag":"net",
+ *      "msg":"connected","host":"example.com","port":80}
+ * 
+ * The time stamp is in nanoseconds since the epoch.  The file, line and 
+ * function of the message follow the message as "file", "line" and "func" 
+ * when they are known, and the fields of the message come last as members 
+ * of the same object, keeping their types.  Non-finite doubles are written 
+ * as null.  The object is written straight into the output, no text is 
+ * built for the message or its fields first.  Thread safe.
+ */
+class JsonLogFormatter final
+  : public ILogFormatter
+{
+public:
+  // constructors
+  JsonLogFormatter() = default;
+  JsonLogFormatter(const JsonLogFormatter&) = default;
+
+  // operators
+  JsonLogFormatter& operator=(const JsonLogFormatter&) = default;
+
+  virtual void append(const LogMessage& msg, std::string& out) override;
+
+  /**
+   * Appends a string to the output as a quoted and escaped JSON string.
+   */
+  static void appendString(StringRef value, std::string& out);
+};
+
+}
+
+#endif
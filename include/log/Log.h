@@ -27,9 +27,79 @@
 #include "prereqs.h"
 #include "log/LogMessage.h"
 #include "log/LogWriter.h"
-#include <unordered_map>
+#include "log/LogWriterSet.h"
+#include "log/AsyncLogQueue.h"
+#include "log/LogFormat.h"
+#include "log/LogStream.h"
+#include "log/LogTag.h"
+#include "log/LogRateLimit.h"
+#include <atomic>
 #include <cstdarg>
-#include <sstream>
+
+/**
+ * The source location of the code that expands the macro.
+ */
+#define LU_LOG_SOURCE ::util::LogSource{__FILE__, __LINE__, __FUNCTION__}
+
+// \{
+/**
+ * Stream logging macros that test the level of the log before anything else 
+ * is evaluated.  When the level is inactive the whole insertion chain, 
+ * including any function calls in it, is skipped by a single branch:
+ * 
+ *     LU_LOG_DEBUG(log, "net") << "peer state " << describePeers();
+ * 
+ * The tag may be a string or a LogTag, in which case the level override of 
+ * the tag is tested instead of the level of the log.  Messages logged 
+ * through the macros carry their source location.  The 
+ * macros are statements, so they are safe to use in an unbraced if/else.  If 
+ * LU_LOG_DISABLE_VERBOSE or LU_LOG_DISABLE_DEBUG is defined, the matching 
+ * macro is compiled but never runs.
+ */
+#define LU_LOG(log, level, tag) \
+  if (!(log).isActive(level, tag)) {} else \
+    (log).stream(level, tag, LU_LOG_SOURCE)
+
+#ifdef LU_LOG_DISABLE_VERBOSE
+  #define LU_LOG_VERBOSE(log, tag) \
+    if (true) {} else (log).stream(::util::LogLevel::Verbose, tag)
+#else
+  #define LU_LOG_VERBOSE(log, tag) LU_LOG(log, ::util::LogLevel::Verbose, tag)
+#endif
+
+#ifdef LU_LOG_DISABLE_DEBUG
+  #define LU_LOG_DEBUG(log, tag) \
+    if (true) {} else (log).stream(::util::LogLevel::Debug, tag)
+#else
+  #define LU_LOG_DEBUG(log, tag) LU_LOG(log, ::util::LogLevel::Debug, tag)
+#endif
+
+#define LU_LOG_INFO(log, tag) LU_LOG(log, ::util::LogLevel::Info, tag)
+#define LU_LOG_WARNING(log, tag) LU_LOG(log, ::util::LogLevel::Warning, tag)
+#define LU_LOG_ERROR(log, tag) LU_LOG(log, ::util::LogLevel::Error, tag)
+// \}
+
+/**
+ * Stream logging macro that throttles its call site with a LogRateLimit, 
+ * after testing the level like LU_LOG:
+ * 
+ *     LU_LOG_LIMITED(log, LogLevel::Error, "db", LogRateLimit::perSecond(10))
+ *       << "query failed: " << error;
+ * 
+ * The site state is created the first time the statement is reached, so 
+ * the limit is only evaluated once and must not refer to local variables.  
+ * Suppressed messages are counted per site and reported by 
+ * LogLimitSite::reportSuppressed(), see LogLimitReporter.
+ */
+#define LU_LOG_LIMITED(log, level, tag, limit) \
+  if (!(log).isActive(level, tag)) {} else \
+  if (!([](::util::LogLevel luLevel, const decltype(tag)& luTag, \
+    const ::util::LogSource& luSource) -> ::util::LogLimitSite& \
+    { \
+      static ::util::LogLimitSite luSite(limit, luLevel, luTag, luSource); \
+      return luSite; \
+    }(level, tag, LU_LOG_SOURCE).tryPass())) {} else \
+    (log).stream(level, tag, LU_LOG_SOURCE)
 
 namespace util
 {
@@ -39,17 +109,26 @@ namespace util
  * encapsulates a set of writers that may direct output to different targets.  
  * Output is filtered based on the level of a message, with filtering done by 
  * both the log itself and each individual writer.
+ * 
+ * Writers may be added and removed while other threads are logging.  A log 
+ * may share its set of writers with other logs, as the logs of a 
+ * LogRegistry do, in which case adding or removing a writer affects all of 
+ * them.
+ * 
+ * By default messages are written on the calling thread.  In asynchronous 
+ * mode (see enableAsync()) messages are queued and written by a background 
+ * thread, so that slow writers do not stall the logging threads.
  */
 class Log final
 {
 private:
   std::string logName;
-  LogLevel outputLevel;
-  std::unordered_map<std::string, StrongLogWriterPtr> writers;
+  std::atomic<LogLevel> outputLevel;
+  StrongPtr<LogWriterSet> writers;
+  std::unique_ptr<AsyncLogQueue> asyncQueue;
 
   class StreamHelper;
   class DummyStreamHelper;
-  class StreamHelperImpl;
 
   using VerboseStreamReturnType =
 #ifdef LU_LOG_DISABLE_VERBOSE
@@ -59,20 +138,43 @@ private:
 #endif
 
   using DebugStreamReturnType =
-#ifdef LU_LOG_DISABLE_VERBOSE
+#ifdef LU_LOG_DISABLE_DEBUG
     DummyStreamHelper;
 #else
     StreamHelper;
 #endif
+
+  // used to select the typed formatting overloads
+  template<typename Format>
+  using EnableIfFormat = 
+    typename std::enable_if<IsFormatString<Format>::value>::type;
   
 public:
   // constructors
   Log() = delete;
-  Log(const Log&) = default;
+
+  /**
+   * Copies the name, level, and writers of a log.  The copy has its own set 
+   * of writers, even if the original shares its set.  The copy is always 
+   * synchronous, even if the original is in asynchronous mode.
+   */
+  Log(const Log& other);
   explicit Log(const std::string& logName, 
     LogLevel outputLevel = LogLevel::All);
+
+  /**
+   * Creates a log that shares a set of writers with other logs.
+   */
+  Log(const std::string& logName, StrongPtr<LogWriterSet> writers, 
+    LogLevel outputLevel = LogLevel::All);
+  // destructor
+  /**
+   * Writes the summaries of the runs of repeats still being counted by the 
+   * writers.
+   */
+  ~Log();
   // operators
-  Log& operator=(const Log&) = default;
+  Log& operator=(const Log& other);
 
   /**
    * Sets the name of this log.
@@ -86,7 +188,9 @@ public:
 
   /**
    * Sets the output level of this log.  Messages below the set level will not 
-   * but output.
+   * but output.  The level of a log in a LogRegistry should be set through 
+   * the registry instead, so that it is passed on to the children of the 
+   * log.
    */
   void setLevel(LogLevel outputLevel);
 
@@ -100,6 +204,19 @@ public:
    */
   bool isActive(LogLevel level) const;
 
+  /**
+   * Returns true if messages at the provided level and tag will be output by 
+   * the log.  If the tag overrides the output level, its level is used 
+   * instead of the level of the log.
+   */
+  bool isActive(LogLevel level, const LogTag& tag) const;
+
+  /**
+   * Same as isActive(level), string tags have no level override.  Allows the 
+   * LU_LOG macros to accept either kind of tag.
+   */
+  bool isActive(LogLevel level, StringRef tag) const;
+
   /**
    * Returns true if the log has a writer with the provided name.
    */
@@ -112,11 +229,57 @@ public:
   bool addWriter(const std::string& name, StrongLogWriterPtr writer);
 
   /**
-   * Removes the writer with the given name.
+   * Removes the writer with the given name.  Waits for any thread that is 
+   * currently writing to it, so the writer is unused by the log on return.  
+   * Must not be called by a writer.
    * \return true if the writer was found and removed.
    */
   bool removeWriter(const std::string& name);
 
+  /**
+   * Switches the log to asynchronous mode.  Messages are copied into a 
+   * bounded queue and written to the writers by a background thread.  If the 
+   * log is already asynchronous the existing queue is drained and replaced.
+   * 
+   * The name and asynchronous mode of the log must not be changed while 
+   * other threads are logging to it.
+   * \param capacity The maximum number of queued messages.
+   * \param policy What to do when the queue is full.
+   */
+  void enableAsync(std::size_t capacity = 8192, 
+    LogOverflowPolicy policy = LogOverflowPolicy::Block);
+
+  /**
+   * Writes any queued messages and returns the log to synchronous mode.  
+   * Does nothing if the log is not asynchronous.
+   */
+  void disableAsync();
+
+  /**
+   * Returns true if the log is in asynchronous mode.
+   */
+  bool isAsync() const;
+
+  /**
+   * Blocks until every message logged before the call has been written, 
+   * including the summaries of runs of repeats whose window has passed.  
+   * Must not be called by a writer.
+   */
+  void flush();
+
+  /**
+   * Returns the number of new messages discarded because the queue was full 
+   * since asynchronous mode was enabled, by the DropNewest policy or by the 
+   * DropOldest policy while the oldest messages were being written.
+   */
+  std::uint64_t getDroppedNewest() const;
+
+  /**
+   * Returns the number of messages discarded by the DropOldest policy since 
+   * asynchronous mode was enabled.
+   */
+  std::uint64_t getDroppedOldest() const;
+
   // \{
   /**
    * These functions are wrappers around log and logf to provide simple or 
@@ -125,21 +288,99 @@ public:
    * If LU_LOG_DISABLE_VERBOSE is defined then the verbose methods are no-ops.
    * If LU_LOG_DISABLE_DEBUG is defined then the debug methods are no-ops.
    */
-  VerboseStreamReturnType verbose(const std::string& tag);
-  void verbose(const std::string& tag, const std::string& msg);
-  void verbosef(const std::string& tag, const char* fmt, ...);
-  DebugStreamReturnType debug(const std::string& tag);
-  void debug(const std::string& tag, const std::string& msg);
-  void debugf(const std::string& tag, const char* fmt, ...);
-  StreamHelper info(const std::string& tag);
-  void info(const std::string& tag, const std::string& msg);
-  void infof(const std::string& tag, const char* fmt, ...);
-  StreamHelper warning(const std::string& tag);
-  void warning(const std::string& tag, const std::string& msg);
-  void warningf(const std::string& tag, const char* fmt, ...);
-  StreamHelper error(const std::string& tag);
-  void error(const std::string& tag, const std::string& msg);
-  void errorf(const std::string& tag, const char* fmt, ...);
+  VerboseStreamReturnType verbose(StringRef tag);
+  void verbose(StringRef tag, StringRef msg);
+  void verbosef(StringRef tag, const char* fmt, ...);
+  DebugStreamReturnType debug(StringRef tag);
+  void debug(StringRef tag, StringRef msg);
+  void debugf(StringRef tag, const char* fmt, ...);
+  StreamHelper info(StringRef tag);
+  void info(StringRef tag, StringRef msg);
+  void infof(StringRef tag, const char* fmt, ...);
+  StreamHelper warning(StringRef tag);
+  void warning(StringRef tag, StringRef msg);
+  void warningf(StringRef tag, const char* fmt, ...);
+  StreamHelper error(StringRef tag);
+  void error(StringRef tag, StringRef msg);
+  void errorf(StringRef tag, const char* fmt, ...);
+  // \}
+
+  // \{
+  /**
+   * Typed versions of the printf style functions.  The format string must be 
+   * created with LU_FMT (see LogFormat.h), and is checked against the 
+   * arguments and split into pieces at compile time.  The message is 
+   * written into a growable per-thread buffer, so it is never truncated.
+   * 
+   * The verbose and debug versions are disabled by the same macros as the 
+   * other verbose and debug methods.
+   */
+  template<typename Format, typename ...Args>
+  EnableIfFormat<Format> verbosef(StringRef tag, Format fmt, 
+    const Args&... args);
+  template<typename Format, typename ...Args>
+  EnableIfFormat<Format> debugf(StringRef tag, Format fmt, 
+    const Args&... args);
+  template<typename Format, typename ...Args>
+  EnableIfFormat<Format> infof(StringRef tag, Format fmt, 
+    const Args&... args);
+  template<typename Format, typename ...Args>
+  EnableIfFormat<Format> warningf(StringRef tag, Format fmt, 
+    const Args&... args);
+  template<typename Format, typename ...Args>
+  EnableIfFormat<Format> errorf(StringRef tag, Format fmt, 
+    const Args&... args);
+  template<typename Format, typename ...Args>
+  EnableIfFormat<Format> logf(LogLevel level, StringRef tag, Format fmt, 
+    const Args&... args);
+  // \}
+
+  // \{
+  /**
+   * Versions of the logging functions for interned tags.  The level is 
+   * tested against the level override of the tag, if it has one, and the 
+   * interned name is passed to the writers.  The verbose and debug versions 
+   * are disabled by the same macros as the other verbose and debug methods.
+   */
+  VerboseStreamReturnType verbose(const LogTag& tag);
+  void verbose(const LogTag& tag, StringRef msg);
+  DebugStreamReturnType debug(const LogTag& tag);
+  void debug(const LogTag& tag, StringRef msg);
+  StreamHelper info(const LogTag& tag);
+  void info(const LogTag& tag, StringRef msg);
+  StreamHelper warning(const LogTag& tag);
+  void warning(const LogTag& tag, StringRef msg);
+  StreamHelper error(const LogTag& tag);
+  void error(const LogTag& tag, StringRef msg);
+  void log(LogLevel level, const LogTag& tag, StringRef msg);
+  template<typename Format, typename ...Args>
+  EnableIfFormat<Format> logf(LogLevel level, const LogTag& tag, 
+    Format fmt, const Args&... args);
+  StreamHelper stream(LogLevel level, const LogTag& tag);
+  StreamHelper stream(LogLevel level, const LogTag& tag, 
+    const LogSource& source);
+  // \}
+
+  // \{
+  /**
+   * Versions of the logging functions that attach typed key/value fields to 
+   * the message, for example:
+   * 
+   *     log.info("net", "connected", {{"host", host}, {"port", 80}});
+   * 
+   * The fields are given to the writers as they are, a formatter such as 
+   * JsonLogFormatter or BinaryRecordLogFormatter encodes them without 
+   * building any text first.  The verbose and debug versions are disabled 
+   * by the same macros as the other verbose and debug methods.
+   */
+  void verbose(StringRef tag, StringRef msg, LogFields fields);
+  void debug(StringRef tag, StringRef msg, LogFields fields);
+  void info(StringRef tag, StringRef msg, LogFields fields);
+  void warning(StringRef tag, StringRef msg, LogFields fields);
+  void error(StringRef tag, StringRef msg, LogFields fields);
+  void log(LogLevel level, StringRef tag, StringRef msg, LogFields fields);
+  void log(LogLevel level, const LogTag& tag, StringRef msg, 
+    LogFields fields);
   // \}
 
   // \{
@@ -147,47 +388,74 @@ public:
    * Process a log message message that is passed to the writers, if the 
    * given level is enabled.
    */
-  void log(LogLevel level, const std::string& tag, const std::string& msg);
-  void logf(LogLevel level, const std::string& tag, const char* fmt, ...);
-  void logv(LogLevel level, const std::string& tag, const char* fmt, 
+  void log(LogLevel level, StringRef tag, StringRef msg);
+  void logf(LogLevel level, StringRef tag, const char* fmt, ...);
+  void logv(LogLevel level, StringRef tag, const char* fmt, 
     va_list args);
   // \}
 
   /**
    * Returns a helper object that allows the log to accept stream input.  
-   * You should never hold a reference to the helper, because if the helper 
-   * outlives the log that created it, bad things will happen.  Also, the 
-   * helper does not forward its accumulated input back to the log until it is 
-   * destroyed.
+   * You should never hold on to the helper, because if the helper outlives 
+   * the log that created it, or the tag it was given, bad things will happen.  
+   * Also, the helper does not forward its accumulated input back to the log 
+   * until it is destroyed.
+   */
+  StreamHelper stream(LogLevel level, StringRef tag);
+
+  /**
+   * Returns a stream helper whose message carries its source location.  
+   * Used by the LU_LOG macros.
    */
-  StreamHelper stream(LogLevel level, const std::string& tag);
+  StreamHelper stream(LogLevel level, StringRef tag, 
+    const LogSource& source);
 
 private:
   /**
    * Creates a LogMessage from the provided parameters and forwards that 
-   * message to the writers of this log.
+   * message to the writers of this log, or queues it in asynchronous mode.
+   */
+  void dispatch(LogLevel level, StringRef tag, StringRef msg, 
+    const LogSource& source = LogSource(), LogFields fields = LogFields());
+
+  /**
+   * Sends a message to all of the writers.
    */
-  void dispatch(LogLevel level, const std::string& tag, const std::string& msg);  
+  void write(const LogMessage& msg);
 
   /**
-   * Helper class that allows logs to accept stream input.  Uses a variant of 
-   * the pimpl idiom with shared pointers so that this object may be copied 
-   * but final writing only occurs when the implementation is destroyed.  
-   * Necessary because returning by value requires an accessible copy 
-   * constructor.
+   * Sends a batch of messages to all of the writers.
+   */
+  void write(const LogMessage* const* msgs, std::size_t count);
+
+  /**
+   * Helper class that allows logs to accept stream input.  The message is 
+   * collected in a stream borrowed from the calling thread and dispatched to 
+   * the log when the helper is destroyed, so no allocation is made per 
+   * message.  If the level was inactive when the helper was created, it 
+   * borrows nothing and inserting into it does nothing.  The helper is 
+   * move-only so that it can be returned by value.
    */
   class StreamHelper final
   {
   private:
-    StrongPtr<StreamHelperImpl> impl;
+    Log* log;
+    LogLevel level;
+    StringRef tag;
+    LogSource source;
+    LogStreamBuffer* buffer;
 
   public:
     using Manipulator = std::ostream& (*)(std::ostream&);
 
     // constructors
     StreamHelper() = delete;
-    StreamHelper(Log& log, LogLevel level, const std::string& tag);
-    StreamHelper(const StreamHelper&) = default;
+    StreamHelper(Log& log, LogLevel level, StringRef tag, 
+      const LogSource& source, bool active);
+    StreamHelper(const StreamHelper&) = delete;
+    StreamHelper(StreamHelper&& other);
+    // destructor
+    ~StreamHelper();
     // operators
     StreamHelper& operator=(const StreamHelper&) = delete;
 
@@ -222,31 +490,6 @@ private:
     DummyStreamHelper& operator<<(const T& arg);
     DummyStreamHelper& operator<<(Manipulator manip);
   };
-
-  /**
-   * Implementation of the stream helper.  Accumulates the log message in a 
-   * stringstream and dispatches the message back to the log when this 
-   * helper is destroyed.
-   */
-  class StreamHelperImpl final
-  {
-  private:
-    Log& log;
-    const LogLevel level;
-    const std::string tag;
-
-  public:
-    std::ostringstream os;
-
-    // constructors
-    StreamHelperImpl() = delete;
-    StreamHelperImpl(Log& log, LogLevel level, const std::string& tag);
-    StreamHelperImpl(const StreamHelperImpl&) = delete;
-    // destructors
-    ~StreamHelperImpl();
-    // operators
-    StreamHelperImpl& operator=(StreamHelperImpl&) = delete;
-  };
 };
 
 using StrongLogPtr = StrongPtr<Log>;
@@ -256,10 +499,26 @@ using WeakLogPtr = WeakPtr<Log>;
 * Definitions
 ****************************************************************************/
 
+inline bool Log::isActive(LogLevel level) const
+{
+  return outputLevel.load(std::memory_order_relaxed) <= level;
+}
+
+inline bool Log::isActive(LogLevel level, const LogTag& tag) const
+{
+  return tag.getLevel(outputLevel.load(std::memory_order_relaxed)) <= level;
+}
+
+inline bool Log::isActive(LogLevel level, StringRef tag) const
+{
+  LU_UNUSED(tag);
+  return isActive(level);
+}
+
 // These functions are inlined so that the disable macros perform correctly 
 // even if we're compiled as a static lib.
 
-inline Log::VerboseStreamReturnType Log::verbose(const std::string& tag)
+inline Log::VerboseStreamReturnType Log::verbose(StringRef tag)
 {
 #ifdef LU_LOG_DISABLE_VERBOSE
   LU_UNUSED(tag);
@@ -269,7 +528,7 @@ inline Log::VerboseStreamReturnType Log::verbose(const std::string& tag)
 #endif
 }
 
-inline void Log::verbose(const std::string& tag, const std::string& msg)
+inline void Log::verbose(StringRef tag, StringRef msg)
 {
 #ifdef LU_LOG_DISABLE_VERBOSE
   LU_UNUSED(tag);
@@ -279,7 +538,7 @@ inline void Log::verbose(const std::string& tag, const std::string& msg)
 #endif
 }
 
-inline void Log::verbosef(const std::string& tag, const char* fmt, ...)
+inline void Log::verbosef(StringRef tag, const char* fmt, ...)
 {
 #ifdef LU_LOG_DISABLE_VERBOSE
   LU_UNUSED(tag);
@@ -292,7 +551,7 @@ inline void Log::verbosef(const std::string& tag, const char* fmt, ...)
 #endif
 }
 
-inline Log::DebugStreamReturnType Log::debug(const std::string& tag)
+inline Log::DebugStreamReturnType Log::debug(StringRef tag)
 {
 #ifdef LU_LOG_DISABLE_DEBUG
   LU_UNUSED(tag);
@@ -302,7 +561,7 @@ inline Log::DebugStreamReturnType Log::debug(const std::string& tag)
 #endif
 }
 
-inline void Log::debug(const std::string& tag, const std::string& msg)
+inline void Log::debug(StringRef tag, StringRef msg)
 {
 #ifdef LU_LOG_DISABLE_DEBUG
   LU_UNUSED(tag);
@@ -312,7 +571,7 @@ inline void Log::debug(const std::string& tag, const std::string& msg)
 #endif
 }
 
-inline void Log::debugf(const std::string& tag, const char* fmt, ...)
+inline void Log::debugf(StringRef tag, const char* fmt, ...)
 {
 #ifdef LU_LOG_DISABLE_DEBUG
   LU_UNUSED(tag);
@@ -325,10 +584,142 @@ inline void Log::debugf(const std::string& tag, const char* fmt, ...)
 #endif
 }
 
+template<typename Format, typename ...Args>
+Log::EnableIfFormat<Format> Log::verbosef(StringRef tag, Format fmt, 
+  const Args&... args)
+{
+#ifdef LU_LOG_DISABLE_VERBOSE
+  // still instantiated so that the format string is checked
+  if (false)
+#endif
+  logf(LogLevel::Verbose, tag, fmt, args...);
+}
+
+template<typename Format, typename ...Args>
+Log::EnableIfFormat<Format> Log::debugf(StringRef tag, Format fmt, 
+  const Args&... args)
+{
+#ifdef LU_LOG_DISABLE_DEBUG
+  // still instantiated so that the format string is checked
+  if (false)
+#endif
+  logf(LogLevel::Debug, tag, fmt, args...);
+}
+
+template<typename Format, typename ...Args>
+Log::EnableIfFormat<Format> Log::infof(StringRef tag, Format fmt, 
+  const Args&... args)
+{
+  logf(LogLevel::Info, tag, fmt, args...);
+}
+
+template<typename Format, typename ...Args>
+Log::EnableIfFormat<Format> Log::warningf(StringRef tag, Format fmt, 
+  const Args&... args)
+{
+  logf(LogLevel::Warning, tag, fmt, args...);
+}
+
+template<typename Format, typename ...Args>
+Log::EnableIfFormat<Format> Log::errorf(StringRef tag, Format fmt, 
+  const Args&... args)
+{
+  logf(LogLevel::Error, tag, fmt, args...);
+}
+
+template<typename Format, typename ...Args>
+Log::EnableIfFormat<Format> Log::logf(LogLevel level, StringRef tag, 
+  Format fmt, const Args&... args)
+{
+  if (isActive(level))
+  {
+    ScopedLogBuffer buffer;
+    formatTo(buffer.get(), fmt, args...);
+    dispatch(level, tag, buffer.get());
+  }
+}
+
+inline Log::VerboseStreamReturnType Log::verbose(const LogTag& tag)
+{
+#ifdef LU_LOG_DISABLE_VERBOSE
+  LU_UNUSED(tag);
+  return DummyStreamHelper();
+#else
+  return stream(LogLevel::Verbose, tag);
+#endif
+}
+
+inline void Log::verbose(const LogTag& tag, StringRef msg)
+{
+#ifdef LU_LOG_DISABLE_VERBOSE
+  LU_UNUSED(tag);
+  LU_UNUSED(msg);
+#else
+  log(LogLevel::Verbose, tag, msg);
+#endif
+}
+
+inline Log::DebugStreamReturnType Log::debug(const LogTag& tag)
+{
+#ifdef LU_LOG_DISABLE_DEBUG
+  LU_UNUSED(tag);
+  return DummyStreamHelper();
+#else
+  return stream(LogLevel::Debug, tag);
+#endif
+}
+
+inline void Log::debug(const LogTag& tag, StringRef msg)
+{
+#ifdef LU_LOG_DISABLE_DEBUG
+  LU_UNUSED(tag);
+  LU_UNUSED(msg);
+#else
+  log(LogLevel::Debug, tag, msg);
+#endif
+}
+
+template<typename Format, typename ...Args>
+Log::EnableIfFormat<Format> Log::logf(LogLevel level, const LogTag& tag, 
+  Format fmt, const Args&... args)
+{
+  if (isActive(level, tag))
+  {
+    ScopedLogBuffer buffer;
+    formatTo(buffer.get(), fmt, args...);
+    dispatch(level, tag.getName(), buffer.get());
+  }
+}
+
+inline void Log::verbose(StringRef tag, StringRef msg, LogFields fields)
+{
+#ifdef LU_LOG_DISABLE_VERBOSE
+  LU_UNUSED(tag);
+  LU_UNUSED(msg);
+  LU_UNUSED(fields);
+#else
+  log(LogLevel::Verbose, tag, msg, fields);
+#endif
+}
+
+inline void Log::debug(StringRef tag, StringRef msg, LogFields fields)
+{
+#ifdef LU_LOG_DISABLE_DEBUG
+  LU_UNUSED(tag);
+  LU_UNUSED(msg);
+  LU_UNUSED(fields);
+#else
+  log(LogLevel::Debug, tag, msg, fields);
+#endif
+}
+
 template<typename T>
 Log::StreamHelper& Log::StreamHelper::operator<<(const T& arg)
 {
-  impl->os << arg;
+  if (buffer)
+  {
+    buffer->stream << arg;
+  }
   return *this;
 }
 
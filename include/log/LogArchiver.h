@@ -0,0 +1,132 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef LOGARCHIVER_H_INCLUDED__
+#define LOGARCHIVER_H_INCLUDED__
+
+#include "prereqs.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * Takes care of log files that are no longer being written.  Files are 
+ * compressed with gzip and the oldest ones are deleted once there are more 
+ * than a set number, all on a background thread so that the writer that 
+ * rotated the file is never blocked.
+ * 
+ * Segments rotated by earlier runs are found when the archiver starts, by 
+ * looking for files named like the ones FileLogWriter rotates to 
+ * (<file>.YYYYMMDD-HHMMSS, with an optional -N counter and .gz suffix), and 
+ * count towards the limit like any other.
+ * 
+ * Compression uses zlib and is only available when the library is built with 
+ * LU_LOG_USE_ZLIB defined.  Without it files are kept uncompressed.
+ */
+class LogArchiver final
+{
+private:
+  const std::size_t maxFiles;
+  const bool compress;
+  const std::string filename;
+  std::deque<std::string> pending;
+  std::deque<std::string> archived;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping;
+  std::thread worker;
+
+public:
+  // constructors
+  LogArchiver() = delete;
+  LogArchiver(const LogArchiver&) = delete;
+
+  /**
+   * Creates the archiver and starts the background thread.
+   * \param maxFiles The number of archived files to keep, or zero to keep 
+   * all of them.
+   * \param compress If true, files are compressed when possible.
+   * \param filename The file whose segments are archived, used to find the 
+   * segments left by earlier runs.
+   */
+  LogArchiver(std::size_t maxFiles, bool compress, 
+    const std::string& filename);
+
+  // destructor
+  /**
+   * Finishes archiving every file that was added and stops the thread.
+   */
+  ~LogArchiver();
+
+  // operators
+  LogArchiver& operator=(const LogArchiver&) = delete;
+
+  /**
+   * Queues a closed file for archiving.  Files must be added oldest first.
+   */
+  void add(const std::string& path);
+
+  /**
+   * Returns true if the library was built with compression support.
+   */
+  static bool isCompressionAvailable();
+
+  /**
+   * Compresses a file with gzip.
+   * \return true if the compressed file was written.
+   */
+  static bool compressFile(const std::string& source, 
+    const std::string& target);
+
+  /**
+   * Returns the segments of a file that are on disk, oldest first.
+   */
+  static std::vector<std::string> findSegments(const std::string& filename);
+
+private:
+  /**
+   * Compresses a file if requested, then deletes the oldest archived files 
+   * beyond the limit.
+   */
+  void archive(std::string path);
+
+  /**
+   * Deletes the oldest archived files beyond the limit.
+   */
+  void prune();
+
+  /**
+   * The loop run by the background thread.
+   */
+  void run();
+};
+
+}
+
+#endif
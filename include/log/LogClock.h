@@ -0,0 +1,217 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef LOGCLOCK_H_INCLUDED__
+#define LOGCLOCK_H_INCLUDED__
+
+#include "prereqs.h"
+#include <atomic>
+#include <chrono>
+
+#if LU_SYSTEM_HAS_TSC
+  #if LU_COMPILER == LU_COMPILER_MSVC
+    #include <intrin.h>
+  #else
+    #include <x86intrin.h>
+  #endif
+#endif
+
+namespace util
+{
+
+/**
+ * The sources LogClock can read the time from.
+ */
+enum class LogClockType : std::uint8_t
+{
+  /** std::chrono::system_clock, the default. */
+  System,
+  /**
+   * The coarse real time clock of the kernel, which is much cheaper to read 
+   * but only advances every few milliseconds.  Same as System on platforms 
+   * without one.
+   */
+  Coarse,
+  /**
+   * The monotonic clock plus an offset to the real time clock.  Time stamps 
+   * never go backwards between calibrations.
+   */
+  Monotonic,
+  /**
+   * The cycle counter of the processor, converted to real time with a rate 
+   * and offset that are calibrated in the background.  The cheapest to read 
+   * and monotonic between calibrations, but requires an invariant counter 
+   * that runs at the same rate on every core.  Same as Monotonic on 
+   * processors without a counter.
+   */
+  Cycle
+};
+
+/**
+ * The process-wide clock that time stamps log messages.  Every clock type 
+ * produces real (wall clock) time, so formatters print correct times 
+ * whichever is used.  The Monotonic and Cycle clocks are calibrated against 
+ * the real time clock by a background thread once a second, which keeps 
+ * them following adjustments of the system time; a calibration may move 
+ * them by the drift since the previous one.
+ */
+class LogClock final
+{
+private:
+  static std::atomic<LogClockType> type;
+
+  // the monotonic clock offset
+  static std::atomic<std::int64_t> monotonicOffset;
+
+  // the cycle counter calibration, guarded by a sequence lock
+  static std::atomic<std::uint64_t> cycleSequence;
+  static std::atomic<std::uint64_t> cycleBase;
+  static std::atomic<std::int64_t> cycleBaseTime;
+  static std::atomic<double> nanosecondsPerCycle;
+
+public:
+  using time_point = std::chrono::system_clock::time_point;
+
+  LogClock() = delete;
+
+  /**
+   * Selects the clock used by now().  Calibrates the clock first if 
+   * needed, which takes a few milliseconds the first time the cycle clock is 
+   * selected, and starts the calibration thread.
+   */
+  static void setType(LogClockType type);
+
+  /**
+   * Returns the selected clock.
+   */
+  static LogClockType getType();
+
+  /**
+   * Returns the current real time according to the selected clock.
+   */
+  static time_point now();
+
+  /**
+   * Recalibrates the monotonic and cycle clocks against the real time 
+   * clock.  Called by the calibration thread.
+   */
+  static void calibrate();
+
+private:
+  /**
+   * Reads the coarse real time clock.
+   */
+  static time_point nowCoarse();
+
+  /**
+   * Reads the monotonic clock and converts it to real time.
+   */
+  static time_point nowMonotonic();
+
+  /**
+   * Reads the cycle counter and converts it to real time.
+   */
+  static time_point nowCycle();
+
+  /**
+   * Returns the value of the cycle counter.
+   */
+  static std::uint64_t readCycles();
+
+  /**
+   * Converts nanoseconds since the epoch to a time point.
+   */
+  static time_point fromNanoseconds(std::int64_t ns);
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline LogClock::time_point LogClock::now()
+{
+  switch (type.load(std::memory_order_relaxed))
+  {
+  case LogClockType::System:
+    break;
+  case LogClockType::Coarse:
+    return nowCoarse();
+  case LogClockType::Monotonic:
+    return nowMonotonic();
+  case LogClockType::Cycle:
+    return nowCycle();
+  }
+  return std::chrono::system_clock::now();
+}
+
+inline LogClock::time_point LogClock::nowMonotonic()
+{
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  return fromNanoseconds(ns + 
+    monotonicOffset.load(std::memory_order_relaxed));
+}
+
+inline LogClock::time_point LogClock::nowCycle()
+{
+  std::uint64_t sequence;
+  std::uint64_t base;
+  std::int64_t baseTime;
+  double rate;
+  std::uint64_t cycles = readCycles();
+  do
+  {
+    sequence = cycleSequence.load(std::memory_order_acquire);
+    base = cycleBase.load(std::memory_order_relaxed);
+    baseTime = cycleBaseTime.load(std::memory_order_relaxed);
+    rate = nanosecondsPerCycle.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) != 0 || 
+    sequence != cycleSequence.load(std::memory_order_relaxed));
+
+  // the counter may have been read just before the base was taken
+  auto elapsed = static_cast<double>(
+    static_cast<std::int64_t>(cycles - base));
+  return fromNanoseconds(baseTime + 
+    static_cast<std::int64_t>(elapsed * rate));
+}
+
+inline std::uint64_t LogClock::readCycles()
+{
+#if LU_SYSTEM_HAS_TSC
+  return __rdtsc();
+#else
+  return static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+inline LogClock::time_point LogClock::fromNanoseconds(std::int64_t ns)
+{
+  return time_point(std::chrono::duration_cast<time_point::duration>(
+    std::chrono::nanoseconds(ns)));
+}
+
+}
+
+#endif
@@ -0,0 +1,285 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef LOGFIELD_H_INCLUDED__
+#define LOGFIELD_H_INCLUDED__
+
+#include "prereqs.h"
+#include "utility/StringRef.h"
+#include <initializer_list>
+#include <string>
+
+namespace util
+{
+
+/**
+ * The type of the value held by a LogField.
+ */
+enum class LogFieldType : std::uint8_t
+{
+  Bool,
+  Int,
+  UInt,
+  Double,
+  String
+};
+
+/**
+ * A typed key/value pair attached to a log message.  Like the rest of the 
+ * message, a field borrows its key and string value, and is only valid for 
+ * the duration of the logging call.  Fields are usually created in place:
+ * 
+ *     log.info("net", "connected", {{"host", host}, {"port", port}});
+ */
+class LogField final
+{
+private:
+  StringRef key;
+  LogFieldType type;
+  union
+  {
+    bool boolValue;
+    long long intValue;
+    unsigned long long uintValue;
+    double doubleValue;
+  };
+  StringRef stringValue;
+
+public:
+  // constructors
+  LogField() = delete;
+  LogField(StringRef key, bool value);
+  LogField(StringRef key, int value);
+  LogField(StringRef key, long value);
+  LogField(StringRef key, long long value);
+  LogField(StringRef key, unsigned value);
+  LogField(StringRef key, unsigned long value);
+  LogField(StringRef key, unsigned long long value);
+  LogField(StringRef key, double value);
+  LogField(StringRef key, const char* value);
+  LogField(StringRef key, const std::string& value);
+  LogField(StringRef key, StringRef value);
+
+  /**
+   * Returns the key of the field.
+   */
+  StringRef getKey() const;
+
+  /**
+   * Returns the type of the value.
+   */
+  LogFieldType getType() const;
+
+  // \{
+  /**
+   * Return the value of the field.  Only the function matching the type of 
+   * the field may be called.
+   */
+  bool getBool() const;
+  long long getInt() const;
+  unsigned long long getUInt() const;
+  double getDouble() const;
+  StringRef getString() const;
+  // \}
+
+  /**
+   * Returns a copy of the field that borrows its key and string value from 
+   * the provided strings instead.
+   */
+  LogField rebind(StringRef key, StringRef stringValue) const;
+};
+
+/**
+ * A borrowed sequence of fields.
+ */
+class LogFields final
+{
+private:
+  const LogField* first;
+  std::size_t count;
+
+public:
+  // constructors
+  LogFields();
+  LogFields(const LogField* first, std::size_t count);
+  LogFields(std::initializer_list<LogField> fields);
+
+  const LogField* begin() const;
+  const LogField* end() const;
+  std::size_t size() const;
+  bool empty() const;
+  const LogField& operator[](std::size_t index) const;
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline LogField::LogField(StringRef key, bool value)
+  : key(key), type(LogFieldType::Bool), boolValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, int value)
+  : key(key), type(LogFieldType::Int), intValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, long value)
+  : key(key), type(LogFieldType::Int), intValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, long long value)
+  : key(key), type(LogFieldType::Int), intValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, unsigned value)
+  : key(key), type(LogFieldType::UInt), uintValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, unsigned long value)
+  : key(key), type(LogFieldType::UInt), uintValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, unsigned long long value)
+  : key(key), type(LogFieldType::UInt), uintValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, double value)
+  : key(key), type(LogFieldType::Double), doubleValue(value), stringValue()
+{
+}
+
+inline LogField::LogField(StringRef key, const char* value)
+  : key(key), type(LogFieldType::String), uintValue(0), 
+    stringValue(value ? value : "")
+{
+}
+
+inline LogField::LogField(StringRef key, const std::string& value)
+  : key(key), type(LogFieldType::String), uintValue(0), stringValue(value)
+{
+}
+
+inline LogField::LogField(StringRef key, StringRef value)
+  : key(key), type(LogFieldType::String), uintValue(0), stringValue(value)
+{
+}
+
+inline StringRef LogField::getKey() const
+{
+  return key;
+}
+
+inline LogFieldType LogField::getType() const
+{
+  return type;
+}
+
+inline bool LogField::getBool() const
+{
+  assert(type == LogFieldType::Bool);
+  return boolValue;
+}
+
+inline long long LogField::getInt() const
+{
+  assert(type == LogFieldType::Int);
+  return intValue;
+}
+
+inline unsigned long long LogField::getUInt() const
+{
+  assert(type == LogFieldType::UInt);
+  return uintValue;
+}
+
+inline double LogField::getDouble() const
+{
+  assert(type == LogFieldType::Double);
+  return doubleValue;
+}
+
+inline StringRef LogField::getString() const
+{
+  assert(type == LogFieldType::String);
+  return stringValue;
+}
+
+inline LogField LogField::rebind(StringRef key, StringRef stringValue) const
+{
+  LogField result(*this);
+  result.key = key;
+  result.stringValue = stringValue;
+  return result;
+}
+
+inline LogFields::LogFields()
+  : first(nullptr), count(0)
+{
+}
+
+inline LogFields::LogFields(const LogField* first, std::size_t count)
+  : first(first), count(count)
+{
+}
+
+inline LogFields::LogFields(std::initializer_list<LogField> fields)
+  : first(std::begin(fields)), count(fields.size())
+{
+}
+
+inline const LogField* LogFields::begin() const
+{
+  return first;
+}
+
+inline const LogField* LogFields::end() const
+{
+  return first + count;
+}
+
+inline std::size_t LogFields::size() const
+{
+  return count;
+}
+
+inline bool LogFields::empty() const
+{
+  return count == 0;
+}
+
+inline const LogField& LogFields::operator[](std::size_t index) const
+{
+  assert(index < count);
+  return first[index];
+}
+
+}
+
+#endif
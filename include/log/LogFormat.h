@@ -0,0 +1,272 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+/** \file
+ * Type-safe formatting with format strings that are checked and split into 
+ * pieces at compile time.  Used by the typed logf family of Log functions:
+ * 
+ *     log.infof("net", LU_FMT("sent {} bytes to {}"), count, host);
+ * 
+ * Each "{}" is replaced by the next argument, and "{{" and "}}" produce 
+ * literal braces.  A format string with the wrong number of placeholders for 
+ * its arguments fails to compile.  Values are written by formatValue(), 
+ * which may be overloaded for user types in the type's namespace.
+ */
+
+#ifndef LOGFORMAT_H_INCLUDED__
+#define LOGFORMAT_H_INCLUDED__
+
+#include "prereqs.h"
+#include "utility/StringRef.h"
+#include <string>
+#include <tuple>
+
+/**
+ * Creates a compile-time format string.  Produces an object of a unique type 
+ * that carries the string as a constant expression.
+ */
+#define LU_FMT(str) \
+  [] { \
+    struct LuFormat : ::util::FormatString { \
+      static constexpr const char* data() { return str; } \
+    }; \
+    return LuFormat(); \
+  }()
+
+namespace util
+{
+
+/**
+ * The base of all format string types created by LU_FMT.
+ */
+struct FormatString
+{
+};
+
+/**
+ * Evaluates to true if T is a format string type created by LU_FMT.
+ */
+template<typename T>
+struct IsFormatString
+  : std::is_base_of<FormatString, T>
+{
+};
+
+// \{
+/**
+ * Appends the text representation of a value to a string.  Overload for 
+ * user types to make them usable with typed formatting.
+ */
+void formatValue(std::string& out, bool value);
+void formatValue(std::string& out, char value);
+void formatValue(std::string& out, int value);
+void formatValue(std::string& out, unsigned int value);
+void formatValue(std::string& out, long value);
+void formatValue(std::string& out, unsigned long value);
+void formatValue(std::string& out, long long value);
+void formatValue(std::string& out, unsigned long long value);
+void formatValue(std::string& out, double value);
+void formatValue(std::string& out, long double value);
+void formatValue(std::string& out, const char* value);
+void formatValue(std::string& out, const std::string& value);
+void formatValue(std::string& out, StringRef value);
+void formatValue(std::string& out, const void* value);
+// \}
+
+/**
+ * Appends the formatted arguments to a string.
+ * \param out The string to append to.
+ * \param fmt A format string created with LU_FMT.
+ * \param args The values to insert at each placeholder.
+ */
+template<typename Format, typename ...Args>
+void formatTo(std::string& out, Format fmt, const Args&... args);
+
+/**
+ * Borrows a string buffer that belongs to the calling thread for the 
+ * lifetime of the object.  The buffer is empty when borrowed and keeps its 
+ * capacity between uses, so formatting into it does not allocate once it has 
+ * grown to fit the messages of the thread.  Nested scopes on the same thread 
+ * receive separate buffers.
+ */
+class ScopedLogBuffer final
+{
+private:
+  std::string& buffer;
+
+public:
+  // constructors
+  ScopedLogBuffer();
+  ScopedLogBuffer(const ScopedLogBuffer&) = delete;
+  // destructor
+  ~ScopedLogBuffer();
+  // operators
+  ScopedLogBuffer& operator=(const ScopedLogBuffer&) = delete;
+
+  /**
+   * Returns the borrowed buffer.
+   */
+  std::string& get();
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+namespace detail
+{
+
+/** The kinds of pieces that make up a format string. */
+enum class FormatPiece
+{
+  End,
+  Literal,
+  EscapedBrace,
+  Argument,
+  Error
+};
+
+/** Returned by countFormatArguments for an invalid format string. */
+static const std::size_t INVALID_FORMAT = static_cast<std::size_t>(-1);
+
+constexpr FormatPiece formatPieceAt(const char* fmt, std::size_t pos)
+{
+  return fmt[pos] == '\0' ? FormatPiece::End :
+    fmt[pos] == '{' ? (
+      fmt[pos + 1] == '{' ? FormatPiece::EscapedBrace :
+      fmt[pos + 1] == '}' ? FormatPiece::Argument : FormatPiece::Error) :
+    fmt[pos] == '}' ? (
+      fmt[pos + 1] == '}' ? FormatPiece::EscapedBrace : FormatPiece::Error) :
+    FormatPiece::Literal;
+}
+
+constexpr std::size_t formatLiteralLength(const char* fmt, std::size_t pos)
+{
+  return formatPieceAt(fmt, pos) == FormatPiece::Literal ?
+    1 + formatLiteralLength(fmt, pos + 1) : 0;
+}
+
+constexpr std::size_t formatPieceLength(const char* fmt, std::size_t pos)
+{
+  return formatPieceAt(fmt, pos) == FormatPiece::Literal ?
+    formatLiteralLength(fmt, pos) : 2;
+}
+
+constexpr std::size_t addFormatArguments(std::size_t count, 
+  std::size_t rest)
+{
+  return rest == INVALID_FORMAT ? INVALID_FORMAT : count + rest;
+}
+
+constexpr std::size_t countFormatArguments(const char* fmt, 
+  std::size_t pos = 0)
+{
+  return formatPieceAt(fmt, pos) == FormatPiece::End ? 0 :
+    formatPieceAt(fmt, pos) == FormatPiece::Error ? INVALID_FORMAT :
+    addFormatArguments(
+      formatPieceAt(fmt, pos) == FormatPiece::Argument ? 1 : 0,
+      countFormatArguments(fmt, pos + formatPieceLength(fmt, pos)));
+}
+
+/**
+ * Appends the piece of the format string at Pos, and then recurses to the 
+ * next piece.  Fully unrolled at compile time.
+ */
+template<typename Format, std::size_t Pos, std::size_t Arg, 
+  FormatPiece Piece = formatPieceAt(Format::data(), Pos)>
+struct FormatRenderer;
+
+template<typename Format, std::size_t Pos, std::size_t Arg>
+struct FormatRenderer<Format, Pos, Arg, FormatPiece::End>
+{
+  template<typename Tuple>
+  static void render(std::string& out, const Tuple& args)
+  {
+    LU_UNUSED(out);
+    LU_UNUSED(args);
+  }
+};
+
+template<typename Format, std::size_t Pos, std::size_t Arg>
+struct FormatRenderer<Format, Pos, Arg, FormatPiece::Literal>
+{
+  static const std::size_t length = 
+    formatLiteralLength(Format::data(), Pos);
+
+  template<typename Tuple>
+  static void render(std::string& out, const Tuple& args)
+  {
+    out.append(Format::data() + Pos, length);
+    FormatRenderer<Format, Pos + length, Arg>::render(out, args);
+  }
+};
+
+template<typename Format, std::size_t Pos, std::size_t Arg>
+struct FormatRenderer<Format, Pos, Arg, FormatPiece::EscapedBrace>
+{
+  template<typename Tuple>
+  static void render(std::string& out, const Tuple& args)
+  {
+    out.push_back(Format::data()[Pos]);
+    FormatRenderer<Format, Pos + 2, Arg>::render(out, args);
+  }
+};
+
+template<typename Format, std::size_t Pos, std::size_t Arg>
+struct FormatRenderer<Format, Pos, Arg, FormatPiece::Argument>
+{
+  template<typename Tuple>
+  static void render(std::string& out, const Tuple& args)
+  {
+    formatValue(out, std::get<Arg>(args));
+    FormatRenderer<Format, Pos + 2, Arg + 1>::render(out, args);
+  }
+};
+
+}
+
+template<typename Format, typename ...Args>
+void formatTo(std::string& out, Format fmt, const Args&... args)
+{
+  static_assert(IsFormatString<Format>::value, 
+    "Format strings must be created with LU_FMT");
+  static_assert(
+    detail::countFormatArguments(Format::data()) != detail::INVALID_FORMAT,
+    "Unmatched brace in format string");
+  static_assert(
+    detail::countFormatArguments(Format::data()) == sizeof...(Args),
+    "Number of format arguments does not match the format string");
+  LU_UNUSED(fmt);
+
+  detail::FormatRenderer<Format, 0, 0>::render(out, 
+    std::tuple<const Args&...>(args...));
+}
+
+inline std::string& ScopedLogBuffer::get()
+{
+  return buffer;
+}
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef LOGFORMATCACHE_H_INCLUDED__
+#define LOGFORMATCACHE_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/ILogFormatter.h"
+#include <string>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * A batch of messages formatted by one formatter.  Each message is followed 
+ * by the terminator of the formatter, usually a newline.
+ */
+struct FormattedLines
+{
+  /** The formatted messages. */
+  std::string text;
+  /** The end of each message in the text, including its terminator. */
+  std::vector<std::size_t> ends;
+
+  /**
+   * Returns all of the formatted messages.
+   */
+  StringRef getAll() const;
+
+  /**
+   * Returns one formatted message, with its terminator.
+   */
+  StringRef getLine(std::size_t index) const;
+};
+
+/**
+ * Formats a batch of messages at most once for each formatter.  A Log passes 
+ * one cache to all of its writers, so writers that share a formatter also 
+ * share the formatted text instead of each formatting the messages again.
+ * 
+ * Only the messages at levels some writer takes from the cache are 
+ * formatted.  A Log has each writer declare its levels with require() before 
+ * any writer formats, so that writers sharing a formatter get one text that 
+ * covers all of them.
+ * 
+ * The text is kept in buffers borrowed from the calling thread, which keep 
+ * their capacity between batches.  Up to MAX_FORMATTERS formatters are 
+ * cached, writers using any others format the messages themselves.
+ */
+class LogFormatCache final
+{
+public:
+  /** The number of formatters the cache holds results for. */
+  static const std::size_t MAX_FORMATTERS = 4;
+
+private:
+  struct Entry
+  {
+    const ILogFormatter* formatter;
+    /** The levels to format, or that were formatted once lines is set. */
+    LogLevelMask levels;
+    FormattedLines* lines;
+  };
+
+  const LogMessage* const* msgs;
+  const std::size_t count;
+  Entry entries[MAX_FORMATTERS];
+  std::size_t entryCount;
+  std::size_t borrowed;
+
+public:
+  // constructors
+  LogFormatCache() = delete;
+  LogFormatCache(const LogFormatCache&) = delete;
+
+  /**
+   * Creates an empty cache for a batch of messages.
+   */
+  LogFormatCache(const LogMessage* const* msgs, std::size_t count);
+
+  // destructor
+  ~LogFormatCache();
+
+  // operators
+  LogFormatCache& operator=(const LogFormatCache&) = delete;
+
+  /**
+   * Returns the number of messages in the batch.
+   */
+  std::size_t getCount() const;
+
+  /**
+   * Returns a message of the batch.
+   */
+  const LogMessage& getMessage(std::size_t index) const;
+
+  /**
+   * Adds levels that a writer will take from the cache formatted by the 
+   * formatter.  Has no effect once the formatter has been used.
+   */
+  void require(const ILogFormatter& formatter, LogLevelMask levels);
+
+  /**
+   * Returns the messages of the batch formatted by the formatter, formatting 
+   * them on first use.  Messages at levels that were neither passed nor 
+   * required are not formatted and have empty lines.
+   * \param levels The levels the calling writer writes.
+   * \return null if the cache is already holding results for 
+   * MAX_FORMATTERS other formatters, or if the formatter was used for fewer 
+   * levels.
+   */
+  const FormattedLines* format(ILogFormatter& formatter, LogLevelMask levels);
+
+private:
+  /**
+   * Returns the entry of the formatter, adding one if there is room.
+   */
+  Entry* findEntry(const ILogFormatter& formatter);
+};
+
+}
+
+#endif
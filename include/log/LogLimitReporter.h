@@ -0,0 +1,88 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef LOGLIMITREPORTER_H_INCLUDED__
+#define LOGLIMITREPORTER_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/LogRateLimit.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace util
+{
+
+/**
+ * Periodically logs how many messages each rate limited call site 
+ * suppressed, using LogLimitSite::reportSuppressed() on a background thread.  
+ * A final report is made when the reporter is destroyed, so no suppressed 
+ * messages go unreported.
+ * 
+ * The log must be asynchronous, since most writers are not thread safe and 
+ * the reports would otherwise race with the application's own messages.
+ */
+class LogLimitReporter final
+{
+private:
+  Log& log;
+  const std::chrono::milliseconds interval;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping;
+  std::thread worker;
+
+public:
+  // constructors
+  LogLimitReporter() = delete;
+  LogLimitReporter(const LogLimitReporter&) = delete;
+
+  /**
+   * Starts the background thread.
+   * \param log The log the reports are written to.  Must be asynchronous 
+   * and outlive the reporter, and must not leave asynchronous mode while 
+   * the reporter exists.
+   * \param interval The time between reports.
+   */
+  explicit LogLimitReporter(Log& log, 
+    std::chrono::milliseconds interval = std::chrono::seconds(60));
+
+  // destructor
+  /**
+   * Stops the thread and makes a final report.
+   */
+  ~LogLimitReporter();
+
+  // operators
+  LogLimitReporter& operator=(const LogLimitReporter&) = delete;
+
+private:
+  /**
+   * The loop run by the background thread.
+   */
+  void run();
+};
+
+}
+
+#endif
@@ -25,6 +25,8 @@
 #define LOGMESSAGE_H_INCLUDED__
 
 #include "prereqs.h"
+#include "log/LogField.h"
+#include "utility/StringRef.h"
 #include <chrono>
 #include <string>
 
@@ -58,7 +60,44 @@ enum class LogLevel
 std::string toString(const LogLevel level);
 
 /**
- * Encapsulates all of the information about a log message.
+ * Get the name of a log level without creating a string.
+ */
+StringRef getLevelName(LogLevel level);
+
+/** A set of log levels, one bit per level. */
+using LogLevelMask = std::uint32_t;
+
+/**
+ * Returns the mask holding only the given level.
+ */
+LogLevelMask getLevelMask(LogLevel level);
+
+/**
+ * Returns the mask holding the given level and every level above it, which 
+ * are the levels written at that output level.
+ */
+LogLevelMask getLevelsFrom(LogLevel level);
+
+/**
+ * The place in the source code where a message was logged.  The strings are 
+ * string literals, so a source can be copied and kept freely.  Messages that 
+ * were not logged through the LU_LOG macros have an empty source.
+ */
+struct LogSource final
+{
+  /** The source file, or null if unknown. */
+  const char* file;
+  /** The line in the source file, or zero if unknown. */
+  unsigned line;
+  /** The enclosing function, or null if unknown. */
+  const char* function;
+};
+
+/**
+ * Encapsulates all of the information about a log message.  The message does 
+ * not own its strings, they are borrowed from the code that created it.  A 
+ * message is only valid for the duration of the call it is passed to, and 
+ * anything that needs to keep it must copy the strings.
  */
 struct LogMessage final
 {
@@ -69,18 +108,33 @@ struct LogMessage final
 
   /** The output level of the message. */
   const LogLevel level;
-  /** The time when the message was created. */
+  /** The time when the message was created, read from LogClock. */
   const std::chrono::system_clock::time_point timeStamp;
   /** The log that created this message. */
-  const std::string logName;
+  const StringRef logName;
   /** The output tag of the message. */
-  const std::string tag;
+  const StringRef tag;
   /** The actual message to be logged. */
-  const std::string message;
+  const StringRef message;
+  /** Where the message was logged from. */
+  const LogSource source;
+  /** The typed fields attached to the message, borrowed like the strings. */
+  const LogFields fields;
 };
 
-using StrongLogMessagePtr = StrongPtr<LogMessage>;
-using WeakLogMessagePtr = WeakPtr<LogMessage>;
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline LogLevelMask getLevelMask(LogLevel level)
+{
+  return LogLevelMask(1) << static_cast<unsigned>(level);
+}
+
+inline LogLevelMask getLevelsFrom(LogLevel level)
+{
+  return ~LogLevelMask(0) << static_cast<unsigned>(level);
+}
 
 }
 
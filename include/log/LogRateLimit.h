@@ -0,0 +1,212 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef LOGRATELIMIT_H_INCLUDED__
+#define LOGRATELIMIT_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/LogMessage.h"
+#include "log/LogTag.h"
+#include "utility/StringRef.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace util
+{
+
+class Log;
+
+/**
+ * The ways a call site can throttle its messages.
+ */
+enum class LogRateLimitType : std::uint8_t
+{
+  /** Keeps up to a number of messages per second, allowing short bursts. */
+  TokenBucket,
+  /** Keeps one message in every N. */
+  Sample,
+  /** Keeps the first N messages, then every Mth message after them. */
+  FirstThenEvery
+};
+
+/**
+ * How a call site throttles its messages.  Created with one of the static 
+ * functions:
+ * 
+ *     LU_LOG_LIMITED(log, LogLevel::Error, "db", LogRateLimit::perSecond(10))
+ *       << "query failed: " << error;
+ */
+struct LogRateLimit
+{
+  LogRateLimitType type;
+  /**
+   * TokenBucket: the messages kept per second.  Sample: keep one message in 
+   * this many.  FirstThenEvery: the number of messages that are always kept.
+   */
+  std::uint32_t count;
+  /**
+   * TokenBucket: the largest burst of messages kept at once.  
+   * FirstThenEvery: keep every this many messages after the first ones.  
+   * Unused by Sample.
+   */
+  std::uint32_t period;
+
+  /**
+   * Keeps at most rate messages per second, and up to burst messages at 
+   * once after a quiet period.
+   */
+  static LogRateLimit perSecond(std::uint32_t rate, std::uint32_t burst = 1);
+
+  /**
+   * Keeps the first message and then one in every n.
+   */
+  static LogRateLimit sample(std::uint32_t n);
+
+  /**
+   * Keeps the first messages, then every Mth message after them.
+   */
+  static LogRateLimit firstThenEvery(std::uint32_t first, 
+    std::uint32_t every);
+};
+
+/**
+ * The throttling state of one call site, created by the LU_LOG_LIMITED macro 
+ * as a function-local static.  The decision to keep or suppress a message is 
+ * lock-free: the sampling limits count calls with a single atomic increment, 
+ * and the token bucket stores the time its next message is due in a single 
+ * atomic, so a suppressed call costs one load, or one increment to count it.
+ * 
+ * Every site is registered in a process-wide list, so the number of messages 
+ * each one suppressed can be reported, see LogLimitReporter.
+ */
+class LogLimitSite final
+{
+private:
+  const LogRateLimit limit;
+  const LogSource source;
+  const LogLevel level;
+  const std::string tag;
+  // the token bucket emits a message every interval and lets the due time 
+  // run ahead of the clock by at most the tolerance
+  const std::int64_t interval;
+  const std::int64_t tolerance;
+  std::atomic<std::uint64_t> calls;
+  std::atomic<std::int64_t> dueTime;
+  std::atomic<std::uint64_t> suppressed;
+  // guarded by the site registry
+  std::uint64_t reported;
+
+public:
+  // constructors
+  LogLimitSite() = delete;
+  LogLimitSite(const LogLimitSite&) = delete;
+
+  /**
+   * Creates and registers a site.
+   * \param limit How messages are throttled.
+   * \param level The level of the messages logged at the site.
+   * \param tag The tag of the messages logged at the site.
+   * \param source Where the site is.
+   */
+  LogLimitSite(const LogRateLimit& limit, LogLevel level, StringRef tag, 
+    const LogSource& source);
+  LogLimitSite(const LogRateLimit& limit, LogLevel level, const LogTag& tag, 
+    const LogSource& source);
+
+  // destructor
+  ~LogLimitSite();
+
+  // operators
+  LogLimitSite& operator=(const LogLimitSite&) = delete;
+
+  /**
+   * Returns true if a message should be logged now, false if it is 
+   * suppressed.  Safe to call from any number of threads.
+   */
+  bool tryPass();
+
+  /**
+   * Returns the number of messages the site has suppressed.
+   */
+  std::uint64_t getSuppressed() const;
+
+  /**
+   * Logs the number of messages each site suppressed since the previous 
+   * report, one message per site with new suppressions.  Each report uses 
+   * the level, tag, and source of its site.
+   * \return The number of sites that were reported.
+   */
+  static std::size_t reportSuppressed(Log& log);
+
+private:
+  /**
+   * The slow part of the token bucket, called when the due time allows a 
+   * message.
+   */
+  bool tryTakeToken(std::int64_t now, std::int64_t due);
+
+  /**
+   * Adds the site to the registry.
+   */
+  void registerSite();
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline bool LogLimitSite::tryPass()
+{
+  switch (limit.type)
+  {
+  case LogRateLimitType::TokenBucket:
+    {
+      auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+      auto due = dueTime.load(std::memory_order_relaxed);
+      if (due - now > tolerance)
+      {
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      return tryTakeToken(now, due);
+    }
+
+  case LogRateLimitType::Sample:
+    return calls.fetch_add(1, std::memory_order_relaxed) % limit.count == 0;
+
+  case LogRateLimitType::FirstThenEvery:
+    {
+      auto call = calls.fetch_add(1, std::memory_order_relaxed);
+      return call < limit.count || 
+        (call - limit.count + 1) % limit.period == 0;
+    }
+  }
+
+  // suppress warnings
+  return true;
+}
+
+}
+
+#endif
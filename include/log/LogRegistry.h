@@ -0,0 +1,90 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef LOGREGISTRY_H_INCLUDED__
+#define LOGREGISTRY_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/Log.h"
+#include <string>
+
+namespace util
+{
+
+/**
+ * A process-wide tree of named logs.  Names are split at dots, so 
+ * "net.http.client" is a child of "net.http", which is a child of "net", 
+ * whose parent is the root log with the empty name.  Logs are created the 
+ * first time they are asked for, along with any missing parents, and live 
+ * until the end of the process, so the returned references are stable 
+ * handles that can be kept:
+ * 
+ *     static Log& log = LogRegistry::get("net.http.client");
+ * 
+ * Every log in the registry shares one set of writers, so a writer added to 
+ * any of them, usually the root, receives the messages of all of them.
+ * 
+ * A level may be set on any log, the others inherit the level of their 
+ * nearest ancestor that has one.  The root always has a level, initially 
+ * LogLevel::All.  The effective level of each log is computed whenever a 
+ * level changes and stored in the log, so testing the level of a message 
+ * stays a single load.
+ * 
+ * Finding a log by name locks the registry and looks the name up in a hash 
+ * table, so frequently used logs should keep their handle.  Thread safe.
+ */
+class LogRegistry final
+{
+public:
+  LogRegistry() = delete;
+
+  /**
+   * Returns the log with the given name, creating it if needed.
+   */
+  static Log& get(const std::string& name);
+
+  /**
+   * Returns the root log.
+   */
+  static Log& getRoot();
+
+  /**
+   * Sets the level of a log and of every descendant that does not have a 
+   * level of its own.  Creates the log if needed.
+   */
+  static void setLevel(const std::string& name, LogLevel level);
+
+  /**
+   * Removes the level of a log, which then inherits the level of its parent 
+   * again.  The level of the root can not be cleared.
+   */
+  static void clearLevel(const std::string& name);
+
+  /**
+   * Returns true if a level was set on the log itself.
+   */
+  static bool hasLevel(const std::string& name);
+};
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef LOGSTREAM_H_INCLUDED__
+#define LOGSTREAM_H_INCLUDED__
+
+#include "prereqs.h"
+#include "utility/StringRef.h"
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace util
+{
+
+/**
+ * An output stream that collects its output in a string.  Used by the stream 
+ * interface of Log.  Each thread keeps one per nesting level and reuses it 
+ * for every message, so once the buffer has grown to fit the messages of the 
+ * thread, building a message does not allocate.
+ */
+class LogStreamBuffer final
+  : public std::streambuf
+{
+private:
+  std::string buffer;
+  char chunk[256];
+
+public:
+  /** Writes into this buffer. */
+  std::ostream stream;
+
+  // constructors
+  LogStreamBuffer();
+  LogStreamBuffer(const LogStreamBuffer&) = delete;
+  // operators
+  LogStreamBuffer& operator=(const LogStreamBuffer&) = delete;
+
+  /**
+   * Discards the output and restores the default formatting state of the 
+   * stream.
+   */
+  void reset();
+
+  /**
+   * Returns the output written so far.  Valid until the next write.
+   */
+  StringRef str();
+
+  /**
+   * Borrows the buffer for the current nesting level of the calling thread.  
+   * The buffer is reset before it is returned.
+   */
+  static LogStreamBuffer& acquire();
+
+  /**
+   * Returns a buffer borrowed with acquire().  Buffers must be released in 
+   * the reverse order they were acquired.
+   */
+  static void release(LogStreamBuffer& buffer);
+
+protected:
+  virtual int_type overflow(int_type ch) override;
+  virtual int sync() override;
+
+private:
+  /**
+   * Moves the contents of the put area into the string.
+   */
+  void flushChunk();
+};
+
+}
+
+#endif
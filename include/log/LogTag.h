@@ -0,0 +1,127 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef LOGTAG_H_INCLUDED__
+#define LOGTAG_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/LogMessage.h"
+#include "utility/StringRef.h"
+#include <atomic>
+
+namespace util
+{
+
+/** The small integer a tag name is interned as. */
+using LogTagId = std::uint32_t;
+
+/**
+ * A tag name that has been interned in a process-wide table.  Interning is 
+ * done once, when the tag is created, after which the tag is a small value 
+ * that refers to the stored name and its id:
+ * 
+ *     static const LogTag NET_TAG("net");
+ *     log.info(NET_TAG, "connected");
+ * 
+ * Every tag may override the output level of the logs it is used with, 
+ * which lets one subsystem log at a different level than the rest of the 
+ * program.  The override is read with a single relaxed load, indexed by the 
+ * tag id.  Tags created with the same name share the same id and level.
+ * 
+ * The table holds at most MAX_TAGS ids.  Once it is full, new names are 
+ * still interned but all share the overflow id zero, and so also share a 
+ * level override.
+ */
+class LogTag final
+{
+public:
+  /** The number of distinct tag ids. */
+  static const std::size_t MAX_TAGS = 4096;
+
+private:
+  // the level override of each tag plus one, zero when there is none
+  static std::atomic<std::uint8_t> levels[MAX_TAGS];
+
+  LogTagId id;
+  StringRef name;
+
+public:
+  // constructors
+  LogTag() = delete;
+
+  /**
+   * Interns a tag name.  Safe to call from any number of threads.
+   */
+  explicit LogTag(StringRef name);
+
+  /**
+   * Returns the id of the tag.
+   */
+  LogTagId getId() const;
+
+  /**
+   * Returns the interned name, which remains valid for the life of the 
+   * process.
+   */
+  StringRef getName() const;
+
+  /**
+   * Overrides the output level of logs for messages with this tag.
+   */
+  void setLevel(LogLevel level) const;
+
+  /**
+   * Removes the level override, so the level of the log applies again.
+   */
+  void clearLevel() const;
+
+  /**
+   * Returns the level override of the tag, or the provided level if the tag 
+   * has none.
+   */
+  LogLevel getLevel(LogLevel defaultLevel) const;
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline LogTagId LogTag::getId() const
+{
+  return id;
+}
+
+inline StringRef LogTag::getName() const
+{
+  return name;
+}
+
+inline LogLevel LogTag::getLevel(LogLevel defaultLevel) const
+{
+  auto level = levels[id].load(std::memory_order_relaxed);
+  return level == 0 ? defaultLevel : static_cast<LogLevel>(level - 1);
+}
+
+}
+
+#endif
@@ -27,6 +27,9 @@
 #include "prereqs.h"
 #include "log/LogMessage.h"
 #include "log/ILogFormatter.h"
+#include "log/LogFormatCache.h"
+#include <chrono>
+#include <memory>
 
 namespace util
 {
@@ -37,23 +40,41 @@ namespace util
  * consistent behavior.  How the message is written to output is determined by
  * the implementation.
  * 
+ * Each message is formatted as one record followed by the terminator of the 
+ * formatter, which is a newline unless the formatter says otherwise.  
+ * Messages are passed to the implementation in batches of complete records, 
+ * so that a batch can be emitted with a single write to the underlying 
+ * target.
+ * 
+ * Optionally, consecutive identical messages can be coalesced: a message 
+ * with the same level, tag, and text as the previous one is counted instead 
+ * of written, and the run is summarized by a single record when a different 
+ * message arrives or its window has passed.
+ * 
  * An implementation should clearly document if it is thread-safe, and whether 
  * or not it requires a thread-safe formatter.
  */
 class LogWriter
 {
 private:
+  struct RepeatState;
+
   StrongLogFormatterPtr formatter;
   LogLevel outputLevel;
+  std::unique_ptr<RepeatState> repeats;
 
 public:
   // constructors
   LogWriter();
-  LogWriter(const LogWriter&) = default;
+  /**
+   * Copies the settings of the writer.  Repeats counted by the other writer 
+   * are not copied.
+   */
+  LogWriter(const LogWriter& other);
   // destructor
-  virtual ~LogWriter() = default;
+  virtual ~LogWriter();
   // operators
-  LogWriter& operator=(const LogWriter&) = default;
+  LogWriter& operator=(const LogWriter& other);
 
   /**
    * Sets the formatter used by this writer.
@@ -63,7 +84,7 @@ public:
   /**
    * Retrieves the formatter.
    */
-  StrongLogFormatterPtr getFormatter() const;
+  const StrongLogFormatterPtr& getFormatter() const;
 
   /**
    * Sets the output level of the writer.
@@ -80,16 +101,97 @@ public:
    */
   bool isActive(LogLevel level) const;
 
+  /**
+   * Returns the levels being written.
+   */
+  LogLevelMask getLevelMask() const;
+
+  /**
+   * Enables or disables coalescing of repeated messages.  While enabled, a 
+   * message with the same level, tag, and text as the previous message 
+   * written is not output.  Instead, when the run of repeats ends, one 
+   * record is written with the message "Last message repeated N times", 
+   * the time of the last repeat, and the fields "repeated", "first" and 
+   * "last", the times being in nanoseconds since the epoch.  Messages are 
+   * compared by hash first, so a message that is not a repeat costs little 
+   * more than the hash.
+   * 
+   * Writes to a coalescing writer are serialized.  Like the formatter, this 
+   * should be set before the writer is added to a log.
+   * \param enabled True to coalesce repeats.
+   * \param window The longest time a run is counted for.  A run is 
+   * summarized once this has passed since its start, when the next message 
+   * is written or the log is flushed, so a long storm is still reported 
+   * periodically and a run that ends in silence is not held back.
+   */
+  void setCoalescing(bool enabled, 
+    std::chrono::milliseconds window = std::chrono::seconds(30));
+
+  /**
+   * Returns true if repeated messages are coalesced.
+   */
+  bool isCoalescing() const;
+
+  /**
+   * Writes the summary of the current run of repeats, if there is one, 
+   * without waiting for a different message.
+   */
+  void flushRepeats();
+
+  /**
+   * Writes the summary of the current run of repeats if its window has 
+   * passed.  Called by Log::flush().
+   */
+  void flushExpiredRepeats();
+
   /**
    * Sends a single message to the writer.  
    */
-  void write(StrongLogMessagePtr msg);
+  void write(const LogMessage& msg);
+
+  /**
+   * Sends a batch of messages to the writer.  The active messages are 
+   * formatted into one buffer and passed to output() in a single call.
+   * \param msgs Pointers to the messages.
+   * \param count The number of messages.
+   */
+  void write(const LogMessage* const* msgs, std::size_t count);
+
+  /**
+   * Tells the cache which messages the writer will take formatted from it.  
+   * Called for every writer of a log before any of them writes the batch.  
+   * Writers that do not use the cache, like FlightRecorderLogWriter, 
+   * override this to do nothing.
+   */
+  virtual void prepare(LogFormatCache& cache);
+
+  /**
+   * Sends a batch of messages to the writer, taking the formatted text from 
+   * the cache.  If every message is active, the text shared with other 
+   * writers is passed to output() without being copied.  Writers that keep 
+   * messages unformatted, like FlightRecorderLogWriter, override this.
+   */
+  virtual void write(LogFormatCache& cache);
+
+private:
+  /**
+   * Version of write() used when repeats are coalesced.
+   */
+  void writeCoalesced(LogFormatCache& cache);
+
+  /**
+   * Appends the summary of the current run of repeats, if there is one, and 
+   * resets the count.  Must be called with the repeat state locked.
+   */
+  void appendRepeats(std::string& lines);
 
 protected:
   /**
-   * Implemented by the writer to output the message.
+   * Implemented by the writer to output formatted messages.
+   * \param lines One or more complete records, each ending in the 
+   * terminator of the formatter.
    */
-  virtual void output(const std::string& msg) = 0;
+  virtual void output(StringRef lines) = 0;
 };
 
 using StrongLogWriterPtr = StrongPtr<LogWriter>;
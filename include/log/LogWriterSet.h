@@ -0,0 +1,127 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef LOGWRITERSET_H_INCLUDED__
+#define LOGWRITERSET_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/LogWriter.h"
+#include "utility/Rcu.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * A set of named log writers that may be changed while other threads are 
+ * logging.  Every change publishes a new immutable snapshot of the set.  
+ * Readers walk the current snapshot inside an RCU read-side critical 
+ * section, so they never take a lock or touch a reference count.  Changes 
+ * are serialized by a mutex and wait for readers of the old snapshot before 
+ * releasing it, so once remove() returns the writer is no longer in use by 
+ * the set.
+ * 
+ * Writers must not change the set from inside forEach().
+ */
+class LogWriterSet final
+{
+public:
+  /** A writer and the name it was added with. */
+  using Entry = std::pair<std::string, StrongLogWriterPtr>;
+  /** An immutable version of the set. */
+  using Snapshot = std::vector<Entry>;
+
+private:
+  std::atomic<const Snapshot*> current;
+  std::mutex updateMutex;
+
+public:
+  // constructors
+  LogWriterSet();
+  LogWriterSet(const LogWriterSet& other);
+  // destructor
+  ~LogWriterSet();
+  // operators
+  LogWriterSet& operator=(const LogWriterSet& other);
+
+  /**
+   * Returns true if the set has a writer with the provided name.
+   */
+  bool has(const std::string& name) const;
+
+  /**
+   * Adds a writer with the given name.
+   * \return false if a writer already exists with that name.
+   */
+  bool add(const std::string& name, StrongLogWriterPtr writer);
+
+  /**
+   * Removes the writer with the given name.
+   * \return true if the writer was found and removed.
+   */
+  bool remove(const std::string& name);
+
+  /**
+   * Removes all writers.
+   */
+  void clear();
+
+  /**
+   * Returns the number of writers.
+   */
+  std::size_t size() const;
+
+  /**
+   * Calls func with a reference to each writer in the current snapshot.
+   */
+  template<typename Func>
+  void forEach(Func func) const;
+
+private:
+  /**
+   * Publishes a new snapshot and releases the old one once it is unused.  
+   * The update mutex must be held.
+   */
+  void publish(const Snapshot* snapshot);
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+template<typename Func>
+void LogWriterSet::forEach(Func func) const
+{
+  Rcu::ReadLock lock;
+  for (const auto& entry : *Rcu::dereference(current))
+  {
+    func(*entry.second);
+  }
+}
+
+}
+
+#endif
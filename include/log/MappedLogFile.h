@@ -0,0 +1,152 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef MAPPEDLOGFILE_H_INCLUDED__
+#define MAPPEDLOGFILE_H_INCLUDED__
+
+#include "prereqs.h"
+#include "utility/StringRef.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * An append-only file that is written through a memory mapping.  The file is 
+ * preallocated in large extents and a window of it is mapped at a time; the 
+ * window slides forward as it fills.  Appends reserve space by advancing an 
+ * atomic tail offset, so any number of threads may append concurrently and 
+ * most appends are a single copy into the mapping.
+ * 
+ * The mapped window is published with Rcu, so an append that misses the 
+ * current window can replace it without stalling appends that hit it.  The 
+ * old window is unmapped by a later slide once its grace period has elapsed, 
+ * which lets appends run inside a read-side critical section, as they do 
+ * when called by a Log.  Data that falls behind the window is written with 
+ * pwrite() instead.  On close 
+ * the file is truncated to the length that was actually written.
+ * 
+ * Only available on Linux.  Elsewhere open() always fails.
+ */
+class MappedLogFile final
+{
+public:
+  /** The default size of each extent allocated to the file. */
+  static const std::size_t DEFAULT_EXTENT_SIZE = 8 * 1024 * 1024;
+
+private:
+  struct Window
+  {
+    std::uint64_t offset;
+    std::size_t size;
+    char* data;
+  };
+
+  struct RetiredWindow
+  {
+    Window* window;
+    std::uint64_t gracePeriod;
+  };
+
+  const std::size_t extentSize;
+  int handle;
+  std::atomic<std::uint64_t> tail;
+  std::atomic<Window*> window;
+  std::uint64_t allocated;
+  std::vector<RetiredWindow> retired;
+  std::mutex mutex;
+
+public:
+  // constructors
+  MappedLogFile(const MappedLogFile&) = delete;
+
+  /**
+   * Creates a closed file.
+   * \param extentSize The number of bytes allocated to the file and mapped 
+   * at a time.
+   */
+  explicit MappedLogFile(std::size_t extentSize = DEFAULT_EXTENT_SIZE);
+
+  // destructor
+  ~MappedLogFile();
+
+  // operators
+  MappedLogFile& operator=(const MappedLogFile&) = delete;
+
+  /**
+   * Opens a file for writing.  If a file is currently open it will be closed 
+   * before the new file is opened.
+   * \param filename The path of the file to open.
+   * \param append If true, appends to an existing file.  Otherwise replaces 
+   * the existing file.
+   * \return True if the file was opened.
+   */
+  bool open(const std::string& filename, bool append);
+
+  /**
+   * Unmaps the file and truncates it to the written length.  No thread may 
+   * be appending to the file.
+   */
+  void close();
+
+  /**
+   * Returns true if a file is open.
+   */
+  bool isOpen() const;
+
+  /**
+   * Appends data to the file.  Safe to call from any number of threads.
+   */
+  void append(StringRef data);
+
+  /**
+   * Returns the number of bytes reserved in the file so far.
+   */
+  std::uint64_t getSize() const;
+
+private:
+  /**
+   * Writes data whose reserved range is not in the current window, moving 
+   * the window forward if needed.
+   */
+  void appendSlow(std::uint64_t pos, StringRef data);
+
+  /**
+   * Unmaps the retired windows that are no longer in use, or all of them.  
+   * The mutex must be held.
+   */
+  void reclaim(bool all);
+
+  /**
+   * Extends the preallocated part of the file to at least the given size.  
+   * The mutex must be held.
+   */
+  bool allocate(std::uint64_t size);
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef PATTERNLOGFORMATTER_H_INCLUDED__
+#define PATTERNLOGFORMATTER_H_INCLUDED__
+
+#include "prereqs.h"
+#include "log/ILogFormatter.h"
+#include <string>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * Formats messages according to a pattern, for example the default pattern 
+ * "%time %level [%log] %tag: %msg".  The pattern is compiled once into a 
+ * list of pieces, so formatting a message is a walk over the list that 
+ * appends each piece.  The placeholders are:
+ * 
+ *  - %time  the local time stamp, as "2014-03-01 12:00:00.000"
+ *  - %level the level name
+ *  - %log   the name of the log
+ *  - %tag   the tag
+ *  - %msg   the message
+ *  - %file  the source file, if known
+ *  - %line  the source line, if known
+ *  - %func  the source function, if known
+ *  - %%     a literal percent sign
+ * 
+ * Anything else is copied as is.  The date and time up to the second is 
+ * cached per thread and only rebuilt when the second changes.  Thread safe.
+ */
+class PatternLogFormatter final
+  : public ILogFormatter
+{
+private:
+  enum class PieceType
+  {
+    Literal,
+    Time,
+    Level,
+    LogName,
+    Tag,
+    Message,
+    File,
+    Line,
+    Function
+  };
+
+  struct Piece
+  {
+    PieceType type;
+    std::string text;
+  };
+
+  std::string pattern;
+  std::vector<Piece> pieces;
+
+public:
+  /** The pattern used by the default constructor. */
+  static const char* const DEFAULT_PATTERN;
+
+  // constructors
+  PatternLogFormatter();
+  PatternLogFormatter(const PatternLogFormatter&) = default;
+
+  /**
+   * Creates a formatter with the given pattern.
+   */
+  explicit PatternLogFormatter(const std::string& pattern);
+
+  // operators
+  PatternLogFormatter& operator=(const PatternLogFormatter&) = default;
+
+  /**
+   * Returns the pattern of the formatter.
+   */
+  const std::string& getPattern() const;
+
+  virtual void append(const LogMessage& msg, std::string& out) override;
+
+private:
+  /**
+   * Splits the pattern into pieces.
+   */
+  void compile();
+
+  /**
+   * Appends the time stamp of a message to a string.
+   */
+  static void appendTime(std::chrono::system_clock::time_point timeStamp, 
+    std::string& out);
+};
+
+}
+
+#endif
@@ -51,7 +51,7 @@ public:
   StreamLogWriter& operator=(const StreamLogWriter&) = delete;
 
 protected:
-  virtual void output(const std::string& msg) override;
+  virtual void output(StringRef lines) override;
 };
 
 }
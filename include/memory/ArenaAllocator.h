@@ -0,0 +1,138 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef ARENAALLOCATOR_H_INCLUDED__
+#define ARENAALLOCATOR_H_INCLUDED__
+
+#include "prereqs.h"
+#include "memory/MemoryArena.h"
+
+namespace util
+{
+
+/**
+  * Allocates from the innermost MemoryArena<System> with an active Scope on 
+  * the calling thread. Follows the model set by MemoryAllocator, so arenas 
+  * can be used with create, destroy and StdLibAllocator without passing the 
+  * arena around.
+  * 
+  * Allocating with no active scope fails and returns null. Freeing with no 
+  * active scope, or a block from another arena, is a no-op.
+  */
+template<typename System>
+class ArenaAllocator
+{
+public:
+  /** A shortcut to the usage counter for this allocator. */
+  using Counter = MemoryCounter<System>;
+
+  ArenaAllocator() = delete;
+
+  /**
+    * Allocates a block of memory.
+    * \param[in] sz The size in bytes to allocate.
+    * \return A pointer to the memory allocated, or null on an error.
+    */
+  static void* malloc(const std::size_t sz);
+
+  /**
+    * Allocates a block of memory for an array.
+    * \param[in] sz The size of each element.
+    * \param[in] count The number of elements in the array.
+    * \return A pointer to the memory allocated, or null on an error.
+    */
+  static void* malloc(const std::size_t sz, const std::size_t count);
+
+  /**
+    * Resizes the most recent allocation. See MemoryArena::realloc.
+    * \param ptr The block to resize, or null to allocate a new one.
+    * \param sz The new size of the block.
+    * \return A pointer to the block, or null on an error.
+    */
+  static void* realloc(void* ptr, const std::size_t sz);
+
+  /**
+    * Gives a block back if it is the most recent allocation.
+    * \param[in] ptr The block to free.
+    */
+  static void free(void* ptr);
+
+  /**
+    * Gives a block back if it is the most recent allocation.
+    * \param[in] ptr The block to free.
+    * \param[in] sz The size of the block.
+    */
+  static void free(void* ptr, const std::size_t sz);
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+template<typename System>
+void* ArenaAllocator<System>::malloc(const std::size_t sz)
+{
+  MemoryArena<System>* arena = MemoryArena<System>::getCurrent();
+  assert(arena != nullptr);
+  return arena ? arena->malloc(sz) : nullptr;
+}
+
+template<typename System>
+void* ArenaAllocator<System>::malloc(const std::size_t sz, 
+                                     const std::size_t count)
+{
+  MemoryArena<System>* arena = MemoryArena<System>::getCurrent();
+  assert(arena != nullptr);
+  return arena ? arena->malloc(sz, count) : nullptr;
+}
+
+template<typename System>
+void* ArenaAllocator<System>::realloc(void* ptr, const std::size_t sz)
+{
+  MemoryArena<System>* arena = MemoryArena<System>::getCurrent();
+  assert(arena != nullptr);
+  return arena ? arena->realloc(ptr, sz) : nullptr;
+}
+
+template<typename System>
+void ArenaAllocator<System>::free(void* ptr)
+{
+  MemoryArena<System>* arena = MemoryArena<System>::getCurrent();
+  if (arena)
+  {
+    arena->free(ptr);
+  }
+}
+
+template<typename System>
+void ArenaAllocator<System>::free(void* ptr, const std::size_t sz)
+{
+  MemoryArena<System>* arena = MemoryArena<System>::getCurrent();
+  if (arena)
+  {
+    arena->free(ptr, sz);
+  }
+}
+
+}
+
+#endif
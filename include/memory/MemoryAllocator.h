@@ -30,6 +30,18 @@
 namespace util
 {
 
+/**
+  * A type with the strictest alignment of the fundamental types, which is 
+  * the alignment that std::malloc guarantees.
+  */
+union MaxAlign
+{
+  long double longDouble;
+  long long longLong;
+  void* pointer;
+  void (*function)();
+};
+
 /**
   * Wraps standard allocators into a system that allows for memory usage 
   * tracking. Make a separate class/struct for each subsystem, and the 
@@ -37,12 +49,40 @@ namespace util
   * system.
   * 
   * Custom allocators can be created using this template. Any custom allocator 
-  * should have functions two malloc functions, realloc, and free with 
-  * signatures and functionality matching the functions in this class.
+  * should have functions two malloc functions, realloc, and two free 
+  * functions with signatures and functionality matching the functions in 
+  * this class.
+  * 
+  * Blocks are returned by std::malloc unchanged, so the sized free is the 
+  * one that keeps the counter's current bytes exact; destroy and 
+  * StdLibAllocator use it. An unsized free, or a realloc that moves a block, 
+  * leaves the current bytes unknown. When LU_DEBUG_MEMORY_TRACK_DETAIL is 
+  * defined each block is preceded by a header holding its size and System, 
+  * so every free and realloc is exact and is checked against the System.
   */
 template<typename System>
 class MemoryAllocator
 {
+#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
+private:
+  struct Header
+  {
+    std::size_t size;
+    /** The System's id while the block is live, null once it is freed. */
+    const void* system;
+  };
+
+  static const std::size_t ALIGNMENT = std::alignment_of<MaxAlign>::value;
+  /** The header size, rounded up so blocks keep malloc's alignment. */
+  static const std::size_t HEADER_SIZE = 
+    (sizeof(Header) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+  /**
+    * Returns the header of a live block.
+    */
+  static Header* getHeader(void* ptr);
+#endif
+
 public:
   /** A shortcut to the usage counter for this allocator. */
   using Counter = MemoryCounter<System>;
@@ -58,7 +98,8 @@ public:
     * Allocates a block of memory for an array.
     * \param[in] sz The size of each element.
     * \param[in] count The number of elements in the array.
-    * \return A pointer to the memory allocated, or null on an error.
+    * \return A pointer to the memory allocated, or null if the array is too 
+    * large or on an error.
     */
   static void* malloc(const std::size_t sz, const std::size_t count);
 
@@ -87,24 +128,58 @@ public:
     * \param[in] ptr The memory location to free.
     */
   static void free(void* ptr);
+
+  /**
+    * Frees a previously allocated block of memory whose size is known.
+    * \pre As for the unsized free, and sz must be the size that the block was 
+    * last allocated or reallocated with.
+    * \param[in] ptr The memory location to free.
+    * \param[in] sz The size of the block.
+    */
+  static void free(void* ptr, const std::size_t sz);
 };
 
 /****************************************************************************
 * Definitions
 ****************************************************************************/
 
+#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
+template<typename System>
+typename MemoryAllocator<System>::Header* 
+  MemoryAllocator<System>::getHeader(void* ptr)
+  {
+    Header* header = reinterpret_cast<Header*>(
+      static_cast<char*>(ptr) - HEADER_SIZE);
+    // catch duplicate frees and blocks from other allocators
+    assert(header->system == Counter::getSystemId());
+    return header;
+  }
+#endif
+
 template<typename System>
 void* MemoryAllocator<System>::malloc(const std::size_t sz)
 {
+#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
+  if (sz > std::numeric_limits<std::size_t>::max() - HEADER_SIZE)
+  {
+    return nullptr;
+  }
+  Header* header = static_cast<Header*>(std::malloc(HEADER_SIZE + sz));
+  if (!header)
+  {
+    return nullptr;
+  }
+  header->size = sz;
+  header->system = Counter::getSystemId();
+  void* ptr = reinterpret_cast<char*>(header) + HEADER_SIZE;
+#else
   void* ptr = std::malloc(sz);
+#endif
 
-#if defined(LU_DEBUG_MEMORY_TRACK)
   if (ptr)
   {
     Counter::trackAlloc(ptr, sz);
-  }    
-#endif
-
+  }
   return ptr;
 }
 
@@ -112,15 +187,45 @@ template<typename System>
 void* MemoryAllocator<System>::malloc(const std::size_t sz, 
                                       const std::size_t count)
 {
+  if (count != 0 && sz > std::numeric_limits<std::size_t>::max() / count)
+  {
+    return nullptr;
+  }
   return MemoryAllocator<System>::malloc(sz * count);
 }
 
 template<typename System>
 void* MemoryAllocator<System>::realloc(void* ptr, const std::size_t sz)
 {
+#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
+  if (!ptr)
+  {
+    return MemoryAllocator<System>::malloc(sz);
+  }
+  if (sz > std::numeric_limits<std::size_t>::max() - HEADER_SIZE)
+  {
+    return nullptr;
+  }
+
+  // the old block may be gone once realloc returns, so it is tracked first 
+  // and restored on failure
+  Header* header = getHeader(ptr);
+  const std::size_t oldSize = header->size;
+  Counter::trackFree(ptr, oldSize);
+  Header* newHeader = static_cast<Header*>(
+    std::realloc(header, HEADER_SIZE + sz));
+  if (!newHeader)
+  {
+    Counter::trackAlloc(ptr, oldSize);
+    return nullptr;
+  }
+  newHeader->size = sz;
+  void* newPtr = reinterpret_cast<char*>(newHeader) + HEADER_SIZE;
+  Counter::trackAlloc(newPtr, sz);
+  return newPtr;
+#else
   void* newPtr = std::realloc(ptr, sz);
 
-#if defined(LU_DEBUG_MEMORY_TRACK)
   // free old block, allocate new block
   if (newPtr && ptr)
   {
@@ -132,9 +237,9 @@ void* MemoryAllocator<System>::realloc(void* ptr, const std::size_t sz)
   {
     Counter::trackAlloc(newPtr, sz);
   }
-#endif
 
   return newPtr;
+#endif
 }
 
 template<typename System>
@@ -142,10 +247,31 @@ void MemoryAllocator<System>::free(void* ptr)
 {
   if (ptr)
   {
-#if defined(LU_DEBUG_MEMORY_TRACK)
+#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
+    Header* header = getHeader(ptr);
+    Counter::trackFree(ptr, header->size);
+    header->system = nullptr;
+    std::free(header);
+#else
     Counter::trackFree(ptr);
+    std::free(ptr);
 #endif
+  }
+}
+
+template<typename System>
+void MemoryAllocator<System>::free(void* ptr, const std::size_t sz)
+{
+  if (ptr)
+  {
+#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
+    assert(getHeader(ptr)->size == sz);
+    LU_UNUSED(sz);
+    MemoryAllocator<System>::free(ptr);
+#else
+    Counter::trackFree(ptr, sz);
     std::free(ptr);
+#endif
   }
 }
 
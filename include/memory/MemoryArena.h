@@ -0,0 +1,453 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef MEMORYARENA_H_INCLUDED__
+#define MEMORYARENA_H_INCLUDED__
+
+#include "prereqs.h"
+#include "memory/MemoryAllocator.h"
+#include "memory/MemoryCounter.h"
+
+namespace util
+{
+
+/**
+  * Allocates by bumping a pointer through a chain of chunks, and frees 
+  * everything at once. Suits objects that all die together, such as the 
+  * temporaries of one request.
+  * 
+  * reset() frees every allocation in O(1). Markers and scopes free only what 
+  * was allocated after they were taken. Chunks are kept and reused after a 
+  * reset or rewind, and returned to the system when the arena is destroyed. 
+  * Destructors of objects in the arena are not run.
+  * 
+  * The arena also follows the MemoryAllocator model, with member functions 
+  * in place of static ones. free() only gives memory back when it is the 
+  * most recent allocation, and realloc() can only resize the most recent 
+  * allocation. A Scope makes an arena the one used by ArenaAllocator on the 
+  * calling thread.
+  * 
+  * The counter for System tracks chunks, so it reports the memory held by 
+  * the arena. An arena must only be used by one thread at a time.
+  */
+template<typename System>
+class MemoryArena
+{
+private:
+  struct Chunk
+  {
+    Chunk* next;
+    /** The usable bytes that follow the chunk header. */
+    std::size_t size;
+  };
+
+  static thread_local MemoryArena* threadArena;
+
+  const std::size_t chunkSize;
+  Chunk* first;
+  Chunk* current;
+  char* top;
+  char* end;
+  /** The most recent allocation, or null if it has been freed. */
+  char* last;
+  std::size_t reservedBytes;
+
+  /**
+    * Returns the usable memory of a chunk.
+    */
+  static char* getData(Chunk* chunk);
+
+  /**
+    * Moves to the next chunk, allocating one if it is missing or too small, 
+    * and allocates from it.
+    */
+  void* allocateSlow(const std::size_t sz, const std::size_t alignment);
+
+public:
+  /**
+    * A position in the arena that it can be rewound to.
+    */
+  class Marker
+  {
+  private:
+    friend class MemoryArena;
+
+    Chunk* chunk;
+    char* top;
+
+    Marker(Chunk* chunk, char* top);
+  };
+
+  /**
+    * Frees everything allocated from an arena during its lifetime, and makes 
+    * the arena the one used by ArenaAllocator on the calling thread until it 
+    * ends. Scopes may be nested, on the same arena or on different ones.
+    */
+  class Scope
+  {
+  private:
+    MemoryArena& arena;
+    const Marker marker;
+    MemoryArena* const previous;
+
+  public:
+    // constructors
+    explicit Scope(MemoryArena& arena);
+    Scope(const Scope&) = delete;
+
+    // destructor
+    ~Scope();
+
+    // operators
+    Scope& operator =(const Scope&) = delete;
+  };
+
+  /** A shortcut to the usage counter for this arena. */
+  using Counter = MemoryCounter<System>;
+
+  /** The chunk size used when none is given. */
+  static const std::size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+  /** The alignment of allocations made through malloc. */
+  static const std::size_t DEFAULT_ALIGNMENT = 
+    std::alignment_of<MaxAlign>::value;
+
+  // constructors
+  /**
+    * \param[in] chunkSize The usable size of each chunk. Larger allocations 
+    * get a chunk of their own.
+    */
+  explicit MemoryArena(const std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+  MemoryArena(const MemoryArena&) = delete;
+
+  // destructor
+  ~MemoryArena();
+
+  // operators
+  MemoryArena& operator =(const MemoryArena&) = delete;
+
+  /**
+    * Returns the innermost arena with an active Scope on the calling thread, 
+    * or null if there is none.
+    */
+  static MemoryArena* getCurrent();
+
+  /**
+    * Allocates a block of memory.
+    * \param[in] sz The size in bytes to allocate.
+    * \param[in] alignment The alignment of the block, a power of two.
+    * \return A pointer to the memory allocated, or null on an error.
+    */
+  void* allocate(const std::size_t sz, const std::size_t alignment);
+
+  /**
+    * Allocates a block of memory with the alignment of std::malloc.
+    * \param[in] sz The size in bytes to allocate.
+    * \return A pointer to the memory allocated, or null on an error.
+    */
+  void* malloc(const std::size_t sz);
+
+  /**
+    * Allocates a block of memory for an array.
+    * \param[in] sz The size of each element.
+    * \param[in] count The number of elements in the array.
+    * \return A pointer to the memory allocated, or null on an error.
+    */
+  void* malloc(const std::size_t sz, const std::size_t count);
+
+  /**
+    * Resizes the most recent allocation, moving it if it does not fit in its 
+    * chunk.
+    * \param ptr The block to resize, or null to allocate a new one.
+    * \param sz The new size of the block.
+    * \return A pointer to the block, or null if ptr is not the most recent 
+    * allocation or no memory is left. The original block is still valid 
+    * when null is returned.
+    */
+  void* realloc(void* ptr, const std::size_t sz);
+
+  /**
+    * Gives a block back if it is the most recent allocation. Otherwise it 
+    * stays allocated until the arena is reset or rewound past it.
+    * \param[in] ptr The block to free.
+    */
+  void free(void* ptr);
+
+  /**
+    * As for the unsized free.
+    * \param[in] ptr The block to free.
+    * \param[in] sz The size of the block.
+    */
+  void free(void* ptr, const std::size_t sz);
+
+  /**
+    * Returns the current position, which rewind() can return to.
+    */
+  Marker getMarker() const;
+
+  /**
+    * Frees everything allocated since a marker was taken.
+    * \pre The arena has not been rewound or reset to before the marker since 
+    * it was taken.
+    */
+  void rewind(const Marker& marker);
+
+  /**
+    * Frees everything allocated from the arena.
+    */
+  void reset();
+
+  /**
+    * Returns the bytes of memory held by the arena, including chunk headers.
+    */
+  std::size_t getReservedBytes() const;
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+template<typename System>
+thread_local MemoryArena<System>* MemoryArena<System>::threadArena = nullptr;
+
+template<typename System>
+MemoryArena<System>::Marker::Marker(Chunk* chunk, char* top)
+  : chunk(chunk),
+    top(top)
+{
+}
+
+template<typename System>
+MemoryArena<System>::Scope::Scope(MemoryArena& arena)
+  : arena(arena),
+    marker(arena.getMarker()),
+    previous(threadArena)
+{
+  threadArena = &arena;
+}
+
+template<typename System>
+MemoryArena<System>::Scope::~Scope()
+{
+  arena.rewind(marker);
+  threadArena = previous;
+}
+
+template<typename System>
+MemoryArena<System>::MemoryArena(const std::size_t chunkSize)
+  : chunkSize(chunkSize),
+    first(nullptr),
+    current(nullptr),
+    top(nullptr),
+    end(nullptr),
+    last(nullptr),
+    reservedBytes(0)
+{
+}
+
+template<typename System>
+MemoryArena<System>::~MemoryArena()
+{
+  Chunk* chunk = first;
+  while (chunk)
+  {
+    Chunk* next = chunk->next;
+    MemoryAllocator<System>::free(chunk, sizeof(Chunk) + chunk->size);
+    chunk = next;
+  }
+}
+
+template<typename System>
+char* MemoryArena<System>::getData(Chunk* chunk)
+{
+  return reinterpret_cast<char*>(chunk) + sizeof(Chunk);
+}
+
+template<typename System>
+MemoryArena<System>* MemoryArena<System>::getCurrent()
+{
+  return threadArena;
+}
+
+template<typename System>
+void* MemoryArena<System>::allocate(const std::size_t sz, 
+                                    const std::size_t alignment)
+{
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+  std::uintptr_t address = reinterpret_cast<std::uintptr_t>(top);
+  std::size_t padding = 
+    ((address + alignment - 1) & ~(alignment - 1)) - address;
+  std::size_t available = static_cast<std::size_t>(end - top);
+  if (padding >= available || sz > available - padding)
+  {
+    return allocateSlow(sz, alignment);
+  }
+
+  last = top + padding;
+  top = last + sz;
+  return last;
+}
+
+template<typename System>
+void* MemoryArena<System>::allocateSlow(const std::size_t sz, 
+                                        const std::size_t alignment)
+{
+  if (sz > std::numeric_limits<std::size_t>::max() - sizeof(Chunk) - 
+    alignment)
+  {
+    return nullptr;
+  }
+  const std::size_t needed = sz + alignment - 1;
+
+  // reuse the next chunk kept from before a reset or rewind if it is large 
+  // enough, otherwise put a new one in front of it
+  Chunk* chunk = current ? current->next : first;
+  if (!chunk || chunk->size < needed)
+  {
+    const std::size_t size = needed > chunkSize ? needed : chunkSize;
+    Chunk* newChunk = static_cast<Chunk*>(
+      MemoryAllocator<System>::malloc(sizeof(Chunk) + size));
+    if (!newChunk)
+    {
+      return nullptr;
+    }
+    reservedBytes += sizeof(Chunk) + size;
+    newChunk->size = size;
+    newChunk->next = chunk;
+    if (current)
+    {
+      current->next = newChunk;
+    }
+    else
+    {
+      first = newChunk;
+    }
+    chunk = newChunk;
+  }
+
+  current = chunk;
+  top = getData(chunk);
+  end = top + chunk->size;
+  return allocate(sz, alignment);
+}
+
+template<typename System>
+void* MemoryArena<System>::malloc(const std::size_t sz)
+{
+  return allocate(sz, DEFAULT_ALIGNMENT);
+}
+
+template<typename System>
+void* MemoryArena<System>::malloc(const std::size_t sz, 
+                                  const std::size_t count)
+{
+  if (count != 0 && sz > std::numeric_limits<std::size_t>::max() / count)
+  {
+    return nullptr;
+  }
+  return allocate(sz * count, DEFAULT_ALIGNMENT);
+}
+
+template<typename System>
+void* MemoryArena<System>::realloc(void* ptr, const std::size_t sz)
+{
+  if (!ptr)
+  {
+    return allocate(sz, DEFAULT_ALIGNMENT);
+  }
+  if (ptr != last)
+  {
+    return nullptr;
+  }
+
+  // resize in place when the chunk has room
+  const std::size_t oldSize = static_cast<std::size_t>(top - last);
+  if (sz <= static_cast<std::size_t>(end - last))
+  {
+    top = last + sz;
+    return last;
+  }
+
+  char* oldBlock = last;
+  void* newBlock = allocateSlow(sz, DEFAULT_ALIGNMENT);
+  if (newBlock)
+  {
+    std::memcpy(newBlock, oldBlock, oldSize);
+  }
+  return newBlock;
+}
+
+template<typename System>
+void MemoryArena<System>::free(void* ptr)
+{
+  if (ptr && ptr == last)
+  {
+    top = last;
+    last = nullptr;
+  }
+}
+
+template<typename System>
+void MemoryArena<System>::free(void* ptr, const std::size_t sz)
+{
+  LU_UNUSED(sz);
+  free(ptr);
+}
+
+template<typename System>
+typename MemoryArena<System>::Marker MemoryArena<System>::getMarker() const
+{
+  return Marker(current, top);
+}
+
+template<typename System>
+void MemoryArena<System>::rewind(const Marker& marker)
+{
+  if (!marker.chunk)
+  {
+    reset();
+    return;
+  }
+  current = marker.chunk;
+  top = marker.top;
+  end = getData(current) + current->size;
+  last = nullptr;
+}
+
+template<typename System>
+void MemoryArena<System>::reset()
+{
+  current = first;
+  top = first ? getData(first) : nullptr;
+  end = first ? top + first->size : nullptr;
+  last = nullptr;
+}
+
+template<typename System>
+std::size_t MemoryArena<System>::getReservedBytes() const
+{
+  return reservedBytes;
+}
+
+}
+
+#endif
@@ -20,45 +20,158 @@
 * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 * SOFTWARE.
 */
-
 #ifndef MEMORYCOUNTER_H__
 #define MEMORYCOUNTER_H__
 
 #include "prereqs.h"
-#include <unordered_map>
+#include <atomic>
 
-// Enables tracking of memory allocations when defined
-//#define LU_DEBUG_MEMORY_TRACK
+// Disables tracking of memory allocations when defined. Tracking is on by 
+// default and is cheap enough to leave on in release builds.
+//#define LU_DISABLE_MEMORY_TRACK
 
-// Enables detailed memory tracking when defined. LU_DEBUG_MEMORY_TRACK must 
-// also be defined. When enabled, current usage is tracked as well as total 
-// usage
+// Enables detailed memory tracking when defined. MemoryAllocator puts a 
+// small header holding the size and System of each block in front of it, 
+// which catches double and foreign frees and lets unsized frees and realloc 
+// update the current usage.
 //#define LU_DEBUG_MEMORY_TRACK_DETAIL
 
 namespace util
 {
 
+/**
+  * A snapshot of the memory usage of one subsystem.
+  */
+struct MemoryUsage
+{
+  /** Allocations made over the lifetime of the program. */
+  std::size_t totalAllocs;
+  /** Frees done over the lifetime of the program. */
+  std::size_t totalFrees;
+  /** Bytes allocated over the lifetime of the program. */
+  std::size_t totalBytes;
+  /** Allocations that have not yet been freed. */
+  std::size_t currentAllocs;
+  /** Bytes that have not yet been freed. */
+  std::size_t currentBytes;
+  /** The highest current byte count seen. */
+  std::size_t peakBytes;
+  /** 
+    * False if any free was tracked without its size, in which case the 
+    * current and peak bytes are unknown and reported as zero.
+    */
+  bool bytesKnown;
+};
+
+/**
+  * Hands out the statistics shards used by memory counters. Each thread 
+  * claims a shard of its own the first time it is tracked and gives it back 
+  * when it exits, so a shard only ever has one writer and can be updated 
+  * without atomic read-modify-writes. Counts left in a shard by a thread that 
+  * has exited are simply carried on by the next owner.
+  * 
+  * When more than COUNT - 1 threads are alive the rest share the last shard, 
+  * which is updated with atomic read-modify-writes instead.
+  */
+class MemoryShard final
+{
+private:
+  struct ShardOwner;
+
+  static const std::size_t NO_SHARD = static_cast<std::size_t>(-1);
+
+  static std::atomic<bool> inUse[];
+  static thread_local std::size_t threadShard;
+  static thread_local ShardOwner shardOwner;
+
+  /**
+    * Claims a free shard for the calling thread, or the shared shard if none 
+    * is free.
+    */
+  static std::size_t claimShard();
+
+public:
+  /** The number of shards each counter is split into. */
+  static const std::size_t COUNT = 64;
+  /** The shard used by threads that could not claim their own. */
+  static const std::size_t SHARED = COUNT - 1;
+
+  MemoryShard() = delete;
+
+  /**
+    * Returns the shard index of the calling thread, in [0, COUNT).
+    */
+  static std::size_t getIndex();
+};
+
 /**
   * Tracks memory allocations and deallocations. Make a class/struct for each 
   * subsystem that you wish to track the memory usage of, and supply the type 
   * name as the template parameter to create a new tracker for that subsystem.
+  * 
+  * Counters are split into cache line padded shards, one per thread (see 
+  * MemoryShard), and updated with relaxed loads and stores, so tracking 
+  * never takes a lock and threads do not contend with each other. Readers 
+  * merge the shards, which makes a read a little more expensive and only 
+  * approximately consistent while other threads are allocating.
+  * 
+  * The peak is kept by folding each shard's change in usage into a shared 
+  * total once it exceeds PEAK_BATCH bytes, so it may be low by up to 
+  * PEAK_BATCH bytes per shard.
+  * 
+  * Current usage needs the size of each freed block. Once a free has been 
+  * tracked through trackFree(ptr) the current and peak bytes can no longer 
+  * be known, so they are reported as zero from then on (see 
+  * MemoryUsage::bytesKnown). Allocators should report sizes.
   */
 template<typename System>
 class MemoryCounter
 {
-#if defined(LU_DEBUG_MEMORY_TRACK)
-  static std::size_t totalAllocations;
-  static std::size_t totalFrees;
-  static std::size_t totalBytesAllocated;
+private:
+  struct Shard
+  {
+    char leadPadding[LU_CACHE_LINE_SIZE];
+    std::atomic<std::size_t> allocs;
+    std::atomic<std::size_t> frees;
+    std::atomic<std::size_t> bytesAllocated;
+    std::atomic<std::size_t> bytesFreed;
+    std::atomic<std::size_t> unsizedFrees;
+    /** Change in usage not yet folded into the shared current total. */
+    std::atomic<std::ptrdiff_t> pending;
+    char trailPadding[LU_CACHE_LINE_SIZE];
+  };
 
-#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
-  static std::size_t curNumAllocations;
-  static std::size_t curBytesAllocated;
-  static std::unordered_map<const void*, std::size_t> allocations;
-#endif
-#endif
+  static const char systemId;
+  static Shard shards[MemoryShard::COUNT];
+  static std::atomic<std::ptrdiff_t> current;
+  static std::atomic<std::ptrdiff_t> peak;
+
+  /**
+    * Adds to a counter in the given shard. Only the shared shard needs an 
+    * atomic read-modify-write.
+    */
+  template<typename T>
+  static void add(std::atomic<T>& counter, const T value, 
+                  const std::size_t index);
+
+  /**
+    * Adds a change in usage to a shard, and folds the shard into the shared 
+    * total and peak once it has drifted far enough.
+    */
+  static void addPending(const std::size_t index, const std::ptrdiff_t delta);
 
 public:
+  /** How far a shard's usage may drift before the peak is updated. */
+  static const std::ptrdiff_t PEAK_BATCH = 64 * 1024;
+
+  MemoryCounter() = delete;
+
+  /**
+    * Returns a value that identifies System, and is different for every 
+    * System.
+    */
+  static const void* getSystemId();
+
   /**
     * Returns the total number of allocations that have been made over the 
     * lifetime of the program.
@@ -78,17 +191,27 @@ public:
   static std::size_t getTotalBytes();
 
   /**
-    * Returns the number of allocations that are currently being used. Valid 
-    * only when LU_DEBUG_MEMORY_TRACK_DETAIL is defined.
+    * Returns the number of allocations that are currently being used.
     */
   static std::size_t getCurrentAllocs();
 
   /**
-    * Returns the bytes of memory that are currently in use. Valid only when 
-    * LU_DEBUG_MEMORY_TRACK_DETAIL is defined.
+    * Returns the bytes of memory that are currently in use, or zero if they 
+    * are unknown.
     */
   static std::size_t getCurrentBytes();
 
+  /**
+    * Returns the highest number of bytes that have been in use at once, or 
+    * zero if they are unknown.
+    */
+  static std::size_t getPeakBytes();
+
+  /**
+    * Returns all of the statistics, merging the shards only once.
+    */
+  static MemoryUsage getUsage();
+
   /**
     * Adds an allocation to the memory tracker.
     * \param[in] ptr The address that was allocated.
@@ -97,122 +220,227 @@ public:
   static void trackAlloc(const void* ptr, const std::size_t sz);
 
   /**
-    * Adds a free to the memory tracker.
+    * Adds a free of unknown size to the memory tracker. The current and peak 
+    * bytes are unknown from then on.
     * \param[in] ptr The address that was freed.
     */
   static void trackFree(const void* ptr);
+
+  /**
+    * Adds a free to the memory tracker.
+    * \param[in] ptr The address that was freed.
+    * \param[in] sz The size the block was allocated with.
+    */
+  static void trackFree(const void* ptr, const std::size_t sz);
 };
 
 /****************************************************************************
 * Definitions
 ****************************************************************************/
 
-#if defined(LU_DEBUG_MEMORY_TRACK)
+inline std::size_t MemoryShard::getIndex()
+{
+  if (threadShard == NO_SHARD)
+  {
+    threadShard = claimShard();
+  }
+  return threadShard;
+}
+
 template<typename System>
-std::size_t MemoryCounter<System>::totalAllocations = 0;
+const char MemoryCounter<System>::systemId = 0;
 template<typename System>
-std::size_t MemoryCounter<System>::totalFrees = 0;
+typename MemoryCounter<System>::Shard 
+  MemoryCounter<System>::shards[MemoryShard::COUNT];
 template<typename System>
-std::size_t MemoryCounter<System>::totalBytesAllocated = 0;
+std::atomic<std::ptrdiff_t> MemoryCounter<System>::current(0);
+template<typename System>
+std::atomic<std::ptrdiff_t> MemoryCounter<System>::peak(0);
 
-#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
-  template<typename System>
-  std::size_t MemoryCounter<System>::curNumAllocations = 0;
+template<typename System>
+template<typename T>
+void MemoryCounter<System>::add(std::atomic<T>& counter, const T value, 
+                                const std::size_t index)
+{
+  if (index == MemoryShard::SHARED)
+  {
+    counter.fetch_add(value, std::memory_order_relaxed);
+  }
+  else
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + value, 
+                  std::memory_order_relaxed);
+  }
+}
 
-  template<typename System>
-  std::size_t MemoryCounter<System>::curBytesAllocated = 0;
+template<typename System>
+void MemoryCounter<System>::addPending(const std::size_t index, 
+                                       const std::ptrdiff_t delta)
+{
+  Shard& shard = shards[index];
+  std::ptrdiff_t pending = 0;
+  if (index == MemoryShard::SHARED)
+  {
+    pending = shard.pending.fetch_add(delta, std::memory_order_relaxed) + 
+      delta;
+    if (pending < PEAK_BATCH && pending > -PEAK_BATCH)
+    {
+      return;
+    }
+    pending = shard.pending.exchange(0, std::memory_order_relaxed);
+  }
+  else
+  {
+    pending = shard.pending.load(std::memory_order_relaxed) + delta;
+    if (pending < PEAK_BATCH && pending > -PEAK_BATCH)
+    {
+      shard.pending.store(pending, std::memory_order_relaxed);
+      return;
+    }
+    shard.pending.store(0, std::memory_order_relaxed);
+  }
 
-  template<typename System>
-  std::unordered_map<const void*, std::size_t> 
-    MemoryCounter<System>::allocations;
-#endif
-#endif
+  std::ptrdiff_t total = 
+    current.fetch_add(pending, std::memory_order_relaxed) + pending;
+  std::ptrdiff_t highest = peak.load(std::memory_order_relaxed);
+  while (total > highest && 
+    !peak.compare_exchange_weak(highest, total, std::memory_order_relaxed))
+  {
+  }
+}
+
+template<typename System>
+const void* MemoryCounter<System>::getSystemId()
+{
+  return &systemId;
+}
 
 template<typename System>
 std::size_t MemoryCounter<System>::getTotalAllocs()
 {
-#if defined(LU_DEBUG_MEMORY_TRACK)
-  return totalAllocations;
-#else
-  return 0;
-#endif
+  return getUsage().totalAllocs;
 }
 
 template<typename System>
 std::size_t MemoryCounter<System>::getTotalFrees()
 {
-#if defined(LU_DEBUG_MEMORY_TRACK)
-  return totalFrees;
-#else
-  return 0;
-#endif
+  return getUsage().totalFrees;
 }
 
 template<typename System>
 std::size_t MemoryCounter<System>::getTotalBytes()
 {
-#if defined(LU_DEBUG_MEMORY_TRACK)
-  return totalBytesAllocated;
-#else
-  return 0;
-#endif
+  return getUsage().totalBytes;
 }
 
 template<typename System>
 std::size_t MemoryCounter<System>::getCurrentAllocs()
 {
-#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
-  return curNumAllocations;
-#else
-  return 0;
-#endif
+  return getUsage().currentAllocs;
 }
 
 template<typename System>
 std::size_t MemoryCounter<System>::getCurrentBytes()
 {
-#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
-  return curBytesAllocated;
-#else
-  return 0;
+  return getUsage().currentBytes;
+}
+
+template<typename System>
+std::size_t MemoryCounter<System>::getPeakBytes()
+{
+  return getUsage().peakBytes;
+}
+
+template<typename System>
+MemoryUsage MemoryCounter<System>::getUsage()
+{
+  MemoryUsage usage = { 0, 0, 0, 0, 0, 0, true };
+
+#if !defined(LU_DISABLE_MEMORY_TRACK)
+  std::size_t bytesFreed = 0;
+  std::size_t unsizedFrees = 0;
+  for (const Shard& shard : shards)
+  {
+    usage.totalAllocs += shard.allocs.load(std::memory_order_relaxed);
+    usage.totalFrees += shard.frees.load(std::memory_order_relaxed);
+    usage.totalBytes += shard.bytesAllocated.load(std::memory_order_relaxed);
+    bytesFreed += shard.bytesFreed.load(std::memory_order_relaxed);
+    unsizedFrees += shard.unsizedFrees.load(std::memory_order_relaxed);
+  }
+
+  // shards are read one at a time, so a block may be seen freed but not 
+  // allocated
+  if (usage.totalAllocs > usage.totalFrees)
+  {
+    usage.currentAllocs = usage.totalAllocs - usage.totalFrees;
+  }
+  if (unsizedFrees > 0)
+  {
+    usage.bytesKnown = false;
+    return usage;
+  }
+  if (usage.totalBytes > bytesFreed)
+  {
+    usage.currentBytes = usage.totalBytes - bytesFreed;
+  }
+
+  std::ptrdiff_t highest = peak.load(std::memory_order_relaxed);
+  usage.peakBytes = usage.currentBytes;
+  if (highest > 0 && static_cast<std::size_t>(highest) > usage.peakBytes)
+  {
+    usage.peakBytes = static_cast<std::size_t>(highest);
+  }
 #endif
+
+  return usage;
 }
 
 template<typename System>
 void MemoryCounter<System>::trackAlloc(const void* ptr, const std::size_t sz)
 {
-#if defined(LU_DEBUG_MEMORY_TRACK)
+#if !defined(LU_DISABLE_MEMORY_TRACK)
   assert(ptr != nullptr);
-  totalAllocations++;
-  totalBytesAllocated += sz;
-
-#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
-  assert(allocations.count(ptr) == 0);
-  curNumAllocations++;
-  curBytesAllocated += sz;
-  allocations.emplace(ptr, sz);
-#endif
+  std::size_t index = MemoryShard::getIndex();
+  Shard& shard = shards[index];
+  add<std::size_t>(shard.allocs, 1, index);
+  add(shard.bytesAllocated, sz, index);
+  addPending(index, static_cast<std::ptrdiff_t>(sz));
+#else
+  LU_UNUSED(ptr);
+  LU_UNUSED(sz);
 #endif
 }
 
 template<typename System>
 void MemoryCounter<System>::trackFree(const void* ptr)
 {
-#if defined(LU_DEBUG_MEMORY_TRACK)
-  // catch duplicate frees
+#if !defined(LU_DISABLE_MEMORY_TRACK)
   assert(ptr != nullptr);
-  totalFrees++;
-
-#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
-  auto itr = allocations.find(ptr);
-  assert(itr != allocations.end());
-  curNumAllocations--;
-  curBytesAllocated -= itr->second;
-  allocations.erase(itr);
+  std::size_t index = MemoryShard::getIndex();
+  Shard& shard = shards[index];
+  add<std::size_t>(shard.frees, 1, index);
+  add<std::size_t>(shard.unsizedFrees, 1, index);
+#else
+  LU_UNUSED(ptr);
 #endif
+}
+
+template<typename System>
+void MemoryCounter<System>::trackFree(const void* ptr, const std::size_t sz)
+{
+#if !defined(LU_DISABLE_MEMORY_TRACK)
+  assert(ptr != nullptr);
+  std::size_t index = MemoryShard::getIndex();
+  Shard& shard = shards[index];
+  add<std::size_t>(shard.frees, 1, index);
+  add(shard.bytesFreed, sz, index);
+  addPending(index, -static_cast<std::ptrdiff_t>(sz));
+#else
+  LU_UNUSED(ptr);
+  LU_UNUSED(sz);
 #endif
 }
 
 }
 
-#endif
\ No newline at end of file
+#endif
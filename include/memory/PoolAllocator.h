@@ -0,0 +1,493 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef POOLALLOCATOR_H_INCLUDED__
+#define POOLALLOCATOR_H_INCLUDED__
+
+#include "prereqs.h"
+#include "memory/MemoryCounter.h"
+#include <atomic>
+
+namespace util
+{
+
+/**
+  * Allocates fixed size blocks carved from large slabs. Follows the model set 
+  * by MemoryAllocator, so it can be used with create, destroy and 
+  * StdLibAllocator. It suits node based containers and other code that 
+  * allocates many objects of one size.
+  * 
+  * Requests larger than BlockSize fail and return null, so containers that 
+  * allocate arrays, such as vector or the buckets of unordered_map, cannot use 
+  * a pool.
+  * 
+  * Each thread keeps its free blocks in a cache of its own, so allocating or 
+  * freeing is normally a few instructions with no atomic operations. When a 
+  * cache grows past two batches one batch is spilled to a lock-free global 
+  * stack, and a thread with an empty cache takes the whole stack at once. 
+  * Taking the whole stack with an exchange, rather than popping one batch, 
+  * avoids the ABA problem. Blocks left in a cache when its thread exits are 
+  * spilled as well.
+  * 
+  * Slabs are never returned to the system. The counter for System tracks 
+  * slabs rather than individual blocks, so it reports the memory held by the 
+  * pool.
+  * 
+  * \tparam System The subsystem that is charged for the slabs.
+  * \tparam BlockSize The largest allocation the pool can serve.
+  * \tparam Alignment The alignment of every block, a power of two.
+  */
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+class PoolAllocator
+{
+private:
+  struct FreeBlock
+  {
+    FreeBlock* next;
+    /** In the first block of a batch, the next batch on the stack. */
+    FreeBlock* nextBatch;
+    /** In the first block of a batch, the number of blocks in it. */
+    std::size_t batchCount;
+  };
+
+  struct ThreadCache
+  {
+    FreeBlock* head;
+    std::size_t count;
+    /** Whole batches taken from the global stack. */
+    FreeBlock* batches;
+    /** The part of the last slab that has not been handed out yet. */
+    char* bumpNext;
+    char* bumpEnd;
+    /** Set once the cache has been released at thread exit. */
+    bool released;
+  };
+
+  /**
+    * Releases the thread's cache when the thread exits.
+    */
+  struct CacheOwner
+  {
+    bool active;
+
+    ~CacheOwner();
+  };
+
+  static const std::size_t ALIGNMENT = 
+    Alignment > std::alignment_of<FreeBlock>::value ? 
+    Alignment : std::alignment_of<FreeBlock>::value;
+  static const std::size_t MIN_BLOCK_SIZE = 
+    BlockSize > sizeof(FreeBlock) ? BlockSize : sizeof(FreeBlock);
+
+  static_assert((Alignment & (Alignment - 1)) == 0, 
+                "Alignment must be a power of two");
+
+  static std::atomic<FreeBlock*> spilled;
+  static thread_local ThreadCache threadCache;
+  static thread_local CacheOwner cacheOwner;
+
+  /**
+    * Pushes a chain of batches linked through nextBatch onto the global 
+    * stack.
+    */
+  static void pushBatches(FreeBlock* first, FreeBlock* last);
+
+  /**
+    * Links the blocks in [begin, end) into a batch and pushes it onto the 
+    * global stack.
+    */
+  static void pushRange(char* begin, char* end);
+
+  /**
+    * Moves one batch from the head of the thread's cache to the global stack.
+    */
+  static void spill(ThreadCache& cache);
+
+  /**
+    * Allocates when the thread's cache is empty.
+    */
+  static void* refill(ThreadCache& cache);
+
+  /**
+    * Allocates one block for a thread whose cache has been released.
+    */
+  static void* allocateReleased();
+
+  /**
+    * Frees when the thread's cache is empty or full.
+    */
+  static void freeSlow(ThreadCache& cache, void* ptr);
+
+  /**
+    * Allocates and aligns a new slab.
+    */
+  static char* allocateSlab();
+
+public:
+  /** A shortcut to the usage counter for this allocator. */
+  using Counter = MemoryCounter<System>;
+
+  /** The size of each block, including padding for alignment. */
+  static const std::size_t BLOCK_SIZE = 
+    (MIN_BLOCK_SIZE + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  /** The number of blocks moved to or from the global stack at once. */
+  static const std::size_t BATCH_SIZE = 64;
+  /** The number of blocks in each slab. */
+  static const std::size_t SLAB_BLOCKS = 
+    BLOCK_SIZE * BATCH_SIZE > 64 * 1024 ? BATCH_SIZE : 64 * 1024 / BLOCK_SIZE;
+
+  PoolAllocator() = delete;
+
+  /**
+    * Allocates a block.
+    * \param[in] sz The size in bytes to allocate, at most BlockSize.
+    * \return A pointer to the block, or null if sz is too large or no memory 
+    * is left.
+    */
+  static void* malloc(const std::size_t sz);
+
+  /**
+    * Allocates a block for an array.
+    * \param[in] sz The size of each element.
+    * \param[in] count The number of elements in the array.
+    * \return A pointer to the block, or null if the array is too large or no 
+    * memory is left.
+    */
+  static void* malloc(const std::size_t sz, const std::size_t count);
+
+  /**
+    * Resizes a block. Since every block has the same size this only succeeds 
+    * when sz is at most BlockSize, and the block never moves.
+    * \param ptr The block to resize, or null to allocate a new one.
+    * \param sz The new size of the block.
+    * \return ptr, or a new block if ptr is null, or null if sz is too large.
+    */
+  static void* realloc(void* ptr, const std::size_t sz);
+
+  /**
+    * Returns a block to the pool. Freeing a null pointer is a no-op.
+    * \param[in] ptr The block to free.
+    */
+  static void free(void* ptr);
+
+  /**
+    * Returns a block to the pool.
+    * \param[in] ptr The block to free.
+    * \param[in] sz The size the block was allocated with.
+    */
+  static void free(void* ptr, const std::size_t sz);
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+std::atomic<typename PoolAllocator<System, BlockSize, Alignment>::FreeBlock*>
+  PoolAllocator<System, BlockSize, Alignment>::spilled(nullptr);
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+thread_local 
+  typename PoolAllocator<System, BlockSize, Alignment>::ThreadCache 
+  PoolAllocator<System, BlockSize, Alignment>::threadCache = {
+    nullptr, 0, nullptr, nullptr, nullptr, false
+  };
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+thread_local 
+  typename PoolAllocator<System, BlockSize, Alignment>::CacheOwner 
+  PoolAllocator<System, BlockSize, Alignment>::cacheOwner;
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+PoolAllocator<System, BlockSize, Alignment>::CacheOwner::~CacheOwner()
+{
+  ThreadCache& cache = threadCache;
+  if (cache.head)
+  {
+    cache.head->batchCount = cache.count;
+    pushBatches(cache.head, cache.head);
+  }
+  if (cache.batches)
+  {
+    FreeBlock* last = cache.batches;
+    while (last->nextBatch)
+    {
+      last = last->nextBatch;
+    }
+    pushBatches(cache.batches, last);
+  }
+  if (cache.bumpNext != cache.bumpEnd)
+  {
+    pushRange(cache.bumpNext, cache.bumpEnd);
+  }
+
+  // blocks freed by later thread exit handlers go straight to the stack
+  cache.head = nullptr;
+  cache.count = 0;
+  cache.batches = nullptr;
+  cache.bumpNext = nullptr;
+  cache.bumpEnd = nullptr;
+  cache.released = true;
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void PoolAllocator<System, BlockSize, Alignment>::pushBatches(
+  FreeBlock* first, 
+  FreeBlock* last
+  )
+{
+  FreeBlock* top = spilled.load(std::memory_order_relaxed);
+  do
+  {
+    last->nextBatch = top;
+  } while (!spilled.compare_exchange_weak(top, first, 
+                                          std::memory_order_release, 
+                                          std::memory_order_relaxed));
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void PoolAllocator<System, BlockSize, Alignment>::pushRange(char* begin, 
+                                                            char* end)
+{
+  FreeBlock* first = reinterpret_cast<FreeBlock*>(begin);
+  std::size_t count = 0;
+  for (char* block = begin; block != end; block += BLOCK_SIZE)
+  {
+    char* next = block + BLOCK_SIZE;
+    reinterpret_cast<FreeBlock*>(block)->next = next != end ? 
+      reinterpret_cast<FreeBlock*>(next) : nullptr;
+    count++;
+  }
+  first->batchCount = count;
+  pushBatches(first, first);
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void PoolAllocator<System, BlockSize, Alignment>::spill(ThreadCache& cache)
+{
+  FreeBlock* first = cache.head;
+  FreeBlock* last = first;
+  for (std::size_t i = 1; i < BATCH_SIZE; i++)
+  {
+    last = last->next;
+  }
+  cache.head = last->next;
+  cache.count -= BATCH_SIZE;
+  last->next = nullptr;
+  first->batchCount = BATCH_SIZE;
+  pushBatches(first, first);
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void* PoolAllocator<System, BlockSize, Alignment>::refill(ThreadCache& cache)
+{
+  if (cache.released)
+  {
+    return allocateReleased();
+  }
+  // make sure the cache is handed back when the thread exits
+  cacheOwner.active = true;
+
+  if (!cache.batches)
+  {
+    cache.batches = spilled.exchange(nullptr, std::memory_order_acquire);
+  }
+  if (cache.batches)
+  {
+    FreeBlock* block = cache.batches;
+    cache.batches = block->nextBatch;
+    cache.head = block->next;
+    cache.count = block->batchCount - 1;
+    return block;
+  }
+
+  char* slab = allocateSlab();
+  if (!slab)
+  {
+    return nullptr;
+  }
+  cache.bumpNext = slab + BLOCK_SIZE;
+  cache.bumpEnd = slab + SLAB_BLOCKS * BLOCK_SIZE;
+  return slab;
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void* PoolAllocator<System, BlockSize, Alignment>::allocateReleased()
+{
+  FreeBlock* batches = spilled.exchange(nullptr, std::memory_order_acquire);
+  if (!batches)
+  {
+    char* slab = allocateSlab();
+    if (slab)
+    {
+      pushRange(slab + BLOCK_SIZE, slab + SLAB_BLOCKS * BLOCK_SIZE);
+    }
+    return slab;
+  }
+
+  // keep the first block and put everything else back
+  FreeBlock* block = batches;
+  FreeBlock* rest = block->nextBatch;
+  if (block->next)
+  {
+    block->next->batchCount = block->batchCount - 1;
+    block->next->nextBatch = rest;
+    rest = block->next;
+  }
+  if (rest)
+  {
+    FreeBlock* last = rest;
+    while (last->nextBatch)
+    {
+      last = last->nextBatch;
+    }
+    pushBatches(rest, last);
+  }
+  return block;
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void PoolAllocator<System, BlockSize, Alignment>::freeSlow(ThreadCache& cache, 
+                                                           void* ptr)
+{
+  FreeBlock* block = static_cast<FreeBlock*>(ptr);
+  if (cache.released)
+  {
+    block->next = nullptr;
+    block->batchCount = 1;
+    pushBatches(block, block);
+    return;
+  }
+  if (cache.count == 0)
+  {
+    // make sure the cache is handed back when the thread exits
+    cacheOwner.active = true;
+  }
+
+  block->next = cache.head;
+  cache.head = block;
+  cache.count++;
+  if (cache.count > 2 * BATCH_SIZE)
+  {
+    spill(cache);
+  }
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+char* PoolAllocator<System, BlockSize, Alignment>::allocateSlab()
+{
+  const std::size_t sz = SLAB_BLOCKS * BLOCK_SIZE + ALIGNMENT - 1;
+  void* slab = std::malloc(sz);
+  if (!slab)
+  {
+    return nullptr;
+  }
+  Counter::trackAlloc(slab, sz);
+
+  std::uintptr_t address = reinterpret_cast<std::uintptr_t>(slab);
+  address = (address + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  return reinterpret_cast<char*>(address);
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void* PoolAllocator<System, BlockSize, Alignment>::malloc(const std::size_t sz)
+{
+  if (sz > BlockSize)
+  {
+    return nullptr;
+  }
+
+  ThreadCache& cache = threadCache;
+  FreeBlock* block = cache.head;
+  if (block)
+  {
+    cache.head = block->next;
+    cache.count--;
+    return block;
+  }
+  if (cache.bumpNext != cache.bumpEnd)
+  {
+    void* ptr = cache.bumpNext;
+    cache.bumpNext += BLOCK_SIZE;
+    return ptr;
+  }
+  return refill(cache);
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void* PoolAllocator<System, BlockSize, Alignment>::malloc(
+  const std::size_t sz, 
+  const std::size_t count
+  )
+{
+  if (count != 0 && sz > BlockSize / count)
+  {
+    return nullptr;
+  }
+  return PoolAllocator::malloc(sz * count);
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void* PoolAllocator<System, BlockSize, Alignment>::realloc(
+  void* ptr, 
+  const std::size_t sz
+  )
+{
+  if (!ptr)
+  {
+    return PoolAllocator::malloc(sz);
+  }
+  return sz <= BlockSize ? ptr : nullptr;
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void PoolAllocator<System, BlockSize, Alignment>::free(void* ptr)
+{
+  if (!ptr)
+  {
+    return;
+  }
+
+  ThreadCache& cache = threadCache;
+  if (cache.count == 0 || cache.count == 2 * BATCH_SIZE)
+  {
+    freeSlow(cache, ptr);
+    return;
+  }
+  FreeBlock* block = static_cast<FreeBlock*>(ptr);
+  block->next = cache.head;
+  cache.head = block;
+  cache.count++;
+}
+
+template<typename System, std::size_t BlockSize, std::size_t Alignment>
+void PoolAllocator<System, BlockSize, Alignment>::free(void* ptr, 
+                                                       const std::size_t sz)
+{
+  assert(sz <= BlockSize);
+  LU_UNUSED(sz);
+  PoolAllocator::free(ptr);
+}
+
+}
+
+#endif
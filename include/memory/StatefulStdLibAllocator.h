@@ -0,0 +1,246 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef STATEFULSTDLIBALLOCATOR_H_INCLUDED__
+#define STATEFULSTDLIBALLOCATOR_H_INCLUDED__
+
+#include "prereqs.h"
+#include <limits>
+#include <new>
+
+namespace util
+{
+
+/**
+  * Wraps an allocator instance in a class suitable for usage with the STL, 
+  * so that a container can be bound to one arena or other allocator object. 
+  * Allocator must have member functions matching the model set by 
+  * MemoryAllocator, as MemoryArena does. The instance must outlive every 
+  * container using it.
+  * 
+  * Two allocators are equal only when they use the same instance, and a 
+  * container keeps its instance for its whole life: the 
+  * propagate_on_container traits are all false, like the allocators of 
+  * std::pmr. Assigning between containers bound to different instances 
+  * copies or moves the elements into the target's instance, so a long lived 
+  * container never ends up using a short lived arena. A copy constructed 
+  * container uses the same instance as the original. Swapping containers 
+  * with different instances is undefined.
+  */
+template<typename T, typename Allocator>
+class StatefulStdLibAllocator
+{
+private:
+  Allocator* allocator;
+
+public:
+  // standard types
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using void_pointer = void*;
+  using const_void_pointer = const void*;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::false_type;
+  using is_always_equal = std::false_type;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = StatefulStdLibAllocator<U, Allocator>;
+  };
+
+  // constructors
+  /**
+    * \param[in] allocator The instance to allocate from.
+    */
+  explicit StatefulStdLibAllocator(Allocator& allocator);
+
+  /**
+    * Rebinds an allocator for another type to the same instance.
+    */
+  template<typename U>
+  StatefulStdLibAllocator(const StatefulStdLibAllocator<U, Allocator>& other);
+
+  /**
+    * Returns the instance that memory is allocated from.
+    */
+  Allocator& getAllocator() const;
+
+  /**
+    * Allocate memory without constructing an object.
+    * \param[in] n The number of objects to allocate memory for.
+    * \param[in] cvptr Unused.
+    * \return A pointer to the allocated memory.
+    * \throw std::bad_alloc If the instance returns null.
+    */
+  pointer allocate(const size_type n, const_void_pointer cvptr = nullptr);
+
+  /**
+    * Frees memory previously allocated by allocate, without calling 
+    * destructors.
+    * \param[in] ptr The memory to deallocate.
+    * \param[in] n The number of objects the memory was allocated for.
+    */
+  void deallocate(pointer ptr, const size_type n);
+
+  /**
+    * Returns the maximum number of objects of type T that may be allocated.
+    */
+  size_type max_size() const;
+
+  /**
+    * Constructs an object using previously allocated memory.
+    * \param[in,out] ptr The memory where the object should be constructed, 
+    * points to the constructed object after return.
+    * \param[in] args The parameters that will be passed the the constructor.
+    */
+  template<typename U, typename ...Args>
+  void construct(U* ptr, Args&&... args);
+
+  /**
+    * Calls the destructor of an object, but does not free memory.
+    * \param[in] ptr The object to destroy.
+    */
+  template<typename U>
+  void destroy(U* ptr);
+
+  /**
+    * Returns the allocator used by a copy constructed container, which 
+    * shares this instance.
+    */
+  StatefulStdLibAllocator select_on_container_copy_construction() const;
+};
+
+// allocators are equal when they share an instance
+template<typename T, typename U, typename Allocator>
+bool operator ==(const StatefulStdLibAllocator<T, Allocator>& lhs,
+                 const StatefulStdLibAllocator<U, Allocator>& rhs);
+
+template<typename T, typename U, typename Allocator>
+bool operator !=(const StatefulStdLibAllocator<T, Allocator>& lhs,
+                 const StatefulStdLibAllocator<U, Allocator>& rhs);
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+template<typename T, typename Allocator>
+StatefulStdLibAllocator<T, Allocator>::StatefulStdLibAllocator(
+  Allocator& allocator
+  )
+  : allocator(&allocator)
+{
+}
+
+template<typename T, typename Allocator>
+template<typename U>
+StatefulStdLibAllocator<T, Allocator>::StatefulStdLibAllocator(
+  const StatefulStdLibAllocator<U, Allocator>& other
+  )
+  : allocator(&other.getAllocator())
+{
+}
+
+template<typename T, typename Allocator>
+Allocator& StatefulStdLibAllocator<T, Allocator>::getAllocator() const
+{
+  return *allocator;
+}
+
+template<typename T, typename Allocator>
+typename StatefulStdLibAllocator<T, Allocator>::pointer
+  StatefulStdLibAllocator<T, Allocator>::allocate(const size_type n,
+                                                  const_void_pointer cvptr)
+  {
+    LU_UNUSED(cvptr);
+    if (n > max_size())
+    {
+      throw std::bad_alloc();
+    }
+    pointer ptr = static_cast<pointer>(allocator->malloc(sizeof(T) * n));
+    if (!ptr)
+    {
+      throw std::bad_alloc();
+    }
+    return ptr;
+  }
+
+template<typename T, typename Allocator>
+void StatefulStdLibAllocator<T, Allocator>::deallocate(pointer ptr, 
+                                                       const size_type n)
+{
+  allocator->free(ptr, sizeof(T) * n);
+}
+
+template<typename T, typename Allocator>
+typename StatefulStdLibAllocator<T, Allocator>::size_type
+  StatefulStdLibAllocator<T, Allocator>::max_size() const
+  {
+    return std::numeric_limits<size_type>::max() / sizeof(T);
+  }
+
+template<typename T, typename Allocator>
+template<typename U, typename ...Args>
+void StatefulStdLibAllocator<T, Allocator>::construct(U* ptr, 
+                                                      Args&&... args)
+{
+  new (ptr) U(std::forward<Args>(args)...);
+}
+
+template<typename T, typename Allocator>
+template<typename U>
+void StatefulStdLibAllocator<T, Allocator>::destroy(U* ptr)
+{
+  ptr->~U();
+}
+
+template<typename T, typename Allocator>
+StatefulStdLibAllocator<T, Allocator> 
+  StatefulStdLibAllocator<T, Allocator>::select_on_container_copy_construction(
+  ) const
+  {
+    return *this;
+  }
+
+template<typename T, typename U, typename Allocator>
+bool operator ==(const StatefulStdLibAllocator<T, Allocator>& lhs,
+                 const StatefulStdLibAllocator<U, Allocator>& rhs)
+{
+  return &lhs.getAllocator() == &rhs.getAllocator();
+}
+
+template<typename T, typename U, typename Allocator>
+bool operator !=(const StatefulStdLibAllocator<T, Allocator>& lhs,
+                 const StatefulStdLibAllocator<U, Allocator>& rhs)
+{
+  return !(lhs == rhs);
+}
+
+}
+
+#endif
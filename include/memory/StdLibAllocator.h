@@ -26,13 +26,15 @@
 
 #include "prereqs.h"
 #include <limits>
+#include <new>
 
 namespace util
 {
 
 /**
   * Wraps an allocator in a class suitable for usage with the STL. Allocator 
-  * must conform to the model set by MemoryAllocator.
+  * must conform to the model set by MemoryAllocator. To bind containers to 
+  * an allocator instance, such as an arena, use StatefulStdLibAllocator.
   */
 template<typename T, typename Allocator>
 class StdLibAllocator
@@ -60,6 +62,8 @@ public:
     * \param[in] n The number of objects to allocate memory for.
     * \param[in] cvptr Unused.
     * \return A pointer to the allocated memory.
+    * \throw std::bad_alloc If the allocator returns null, as it does for 
+    * requests a PoolAllocator can not serve.
     */
   pointer allocate(const size_type n, const_void_pointer cvptr = nullptr);
 
@@ -67,7 +71,7 @@ public:
     * Frees memory previously allocated by allocate, without calling 
     * destructors.
     * \param[in] ptr The memory to deallocate.
-    * \param[in] n Unused.
+    * \param[in] n The number of objects the memory was allocated for.
     */
   void deallocate(pointer ptr, const size_type n);
 
@@ -111,14 +115,22 @@ typename StdLibAllocator<T, Allocator>::pointer
                                           const_void_pointer cvptr)
   {
     LU_UNUSED(cvptr);
-    return static_cast<pointer>(Allocator::malloc(sizeof(T) * n));
+    if (n > max_size())
+    {
+      throw std::bad_alloc();
+    }
+    pointer ptr = static_cast<pointer>(Allocator::malloc(sizeof(T) * n));
+    if (!ptr)
+    {
+      throw std::bad_alloc();
+    }
+    return ptr;
   }
 
 template<typename T, typename Allocator>
 void StdLibAllocator<T, Allocator>::deallocate(pointer ptr, const size_type n)
 {
-  LU_UNUSED(n);
-  Allocator::free(ptr);
+  Allocator::free(ptr, sizeof(T) * n);
 }
 
 template<typename T, typename Allocator>
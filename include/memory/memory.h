@@ -25,7 +25,11 @@
 #define MEMORY_H__
 
 #include "prereqs.h"
+#include "memory/ArenaAllocator.h"
 #include "memory/MemoryAllocator.h"
+#include "memory/MemoryArena.h"
+#include "memory/PoolAllocator.h"
+#include "memory/StatefulStdLibAllocator.h"
 #include "memory/StdLibAllocator.h"
 
 namespace util
@@ -128,7 +132,7 @@ void destroy(T* ptr)
   if (ptr)
   {
     ptr->~T();
-    Allocator::free(ptr);
+    Allocator::free(ptr, sizeof(T));
   }
 }
 
@@ -141,7 +145,7 @@ void destroyArray(std::size_t count, T* ptr)
     {
       (ptr + i)->~T();
     }
-    Allocator::free(ptr);
+    Allocator::free(ptr, sizeof(T) * count);
   }
 }
 
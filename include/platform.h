@@ -51,6 +51,14 @@
   #define LU_SYSTEM_ARCH LU_SYSTEM_ARCH_32
 #endif
 
+// detect the x86 time stamp counter
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+  defined(_M_IX86)
+  #define LU_SYSTEM_HAS_TSC 1
+#else
+  #define LU_SYSTEM_HAS_TSC 0
+#endif
+
 // set the endianness (must be manually changed)
 #define LU_SYSTEM_ENDIAN LU_SYSTEM_ENDIAN_LITTLE
 
@@ -34,6 +34,10 @@
 // Use to suppress warnings on unused code.
 #define LU_UNUSED(x) static_cast<void>(x)
 
+// Assumed size of a cache line, used to keep data written by different 
+// threads apart.
+#define LU_CACHE_LINE_SIZE 64
+
 // set compiler specific options
 #if LU_COMPILER == LU_COMPILER_MSVC
   #define _CRT_SECURE_NO_WARNINGS
@@ -0,0 +1,157 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef RCU_H_INCLUDED__
+#define RCU_H_INCLUDED__
+
+#include "prereqs.h"
+#include <atomic>
+
+namespace util
+{
+
+/**
+ * A minimal, process-wide read-copy-update domain.  Readers mark a critical 
+ * section with a ReadLock, which only writes to a per-thread record, so any 
+ * number of threads may read without contending with each other.  Updaters 
+ * publish a new version of the shared data with assign() and then call 
+ * synchronize(), which waits until every reader that may still see the old 
+ * version has left its critical section.  After that the old version can be 
+ * destroyed.
+ * 
+ * Read-side critical sections may be nested.  synchronize() must never be 
+ * called from inside a critical section.  Code that may run inside one can 
+ * instead start a grace period and reclaim the old version once 
+ * hasElapsed() reports that the grace period is over.
+ */
+class Rcu final
+{
+private:
+  struct ThreadRecord;
+  struct RecordOwner;
+
+  static std::atomic<ThreadRecord*> records;
+  static std::atomic<std::uint64_t> globalEpoch;
+  static thread_local ThreadRecord* threadRecord;
+  static thread_local RecordOwner recordOwner;
+
+  /**
+   * Returns the calling thread's record, claiming one if necessary.
+   */
+  static ThreadRecord* getThreadRecord();
+
+public:
+  class ReadLock;
+
+  Rcu() = delete;
+
+  /**
+   * Enters a read-side critical section on the calling thread.
+   */
+  static void lock();
+
+  /**
+   * Leaves a read-side critical section on the calling thread.
+   */
+  static void unlock();
+
+  /**
+   * Waits until all read-side critical sections that were active when the 
+   * call was made have ended.
+   */
+  static void synchronize();
+
+  /**
+   * Starts a grace period without waiting for it to end.  May be called from 
+   * inside a critical section.
+   * \return A token to pass to hasElapsed().
+   */
+  static std::uint64_t startGracePeriod();
+
+  /**
+   * Returns true if all read-side critical sections that were active when the 
+   * grace period started have ended.  Never blocks.
+   */
+  static bool hasElapsed(std::uint64_t gracePeriod);
+
+  /**
+   * Loads an RCU protected pointer.  Must be called inside a read-side 
+   * critical section, and the result may only be used inside that section.
+   */
+  template<typename T>
+  static T* dereference(const std::atomic<T*>& ptr);
+
+  /**
+   * Publishes a new value for an RCU protected pointer.
+   * \return The previous value, which may be reclaimed after synchronize().
+   */
+  template<typename T>
+  static T* assign(std::atomic<T*>& ptr, T* value);
+};
+
+/**
+ * Holds a read-side critical section for its lifetime.
+ */
+class Rcu::ReadLock final
+{
+public:
+  // constructors
+  ReadLock();
+  ReadLock(const ReadLock&) = delete;
+  // destructor
+  ~ReadLock();
+  // operators
+  ReadLock& operator=(const ReadLock&) = delete;
+};
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+template<typename T>
+T* Rcu::dereference(const std::atomic<T*>& ptr)
+{
+  // sequentially consistent so that the load cannot be ordered before the 
+  // reader's record is published in lock()
+  return ptr.load(std::memory_order_seq_cst);
+}
+
+template<typename T>
+T* Rcu::assign(std::atomic<T*>& ptr, T* value)
+{
+  return ptr.exchange(value, std::memory_order_seq_cst);
+}
+
+inline Rcu::ReadLock::ReadLock()
+{
+  Rcu::lock();
+}
+
+inline Rcu::ReadLock::~ReadLock()
+{
+  Rcu::unlock();
+}
+
+}
+
+#endif
@@ -0,0 +1,201 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef STRINGREF_H_INCLUDED__
+#define STRINGREF_H_INCLUDED__
+
+#include "prereqs.h"
+#include <ostream>
+#include <string>
+
+namespace util
+{
+
+/**
+ * A non-owning reference to a sequence of characters.  Used to pass strings 
+ * without copying them.  The referenced characters need not be null 
+ * terminated, and must outlive the reference.
+ */
+class StringRef final
+{
+private:
+  const char* ptr;
+  std::size_t length;
+
+public:
+  // constructors
+  StringRef();
+  StringRef(const StringRef&) = default;
+  StringRef(const char* str);
+  StringRef(const char* str, std::size_t length);
+  StringRef(const std::string& str);
+  // operators
+  StringRef& operator=(const StringRef&) = default;
+  char operator[](std::size_t index) const;
+
+  /**
+   * Returns a pointer to the first character.  Not null terminated.
+   */
+  const char* data() const;
+
+  /**
+   * Returns the number of characters.
+   */
+  std::size_t size() const;
+
+  /**
+   * Returns true if there are no characters.
+   */
+  bool empty() const;
+
+  // \{
+  /**
+   * Iterators over the characters.
+   */
+  const char* begin() const;
+  const char* end() const;
+  // \}
+
+  /**
+   * Copies the characters into a new string.
+   */
+  std::string str() const;
+
+  /**
+   * Lexicographically compares two strings, with the same result as 
+   * std::string::compare.
+   */
+  int compare(StringRef other) const;
+};
+
+bool operator==(StringRef lhs, StringRef rhs);
+bool operator!=(StringRef lhs, StringRef rhs);
+bool operator<(StringRef lhs, StringRef rhs);
+
+/**
+ * Appends the referenced characters to a string.
+ */
+std::string& operator+=(std::string& lhs, StringRef rhs);
+
+std::ostream& operator<<(std::ostream& os, StringRef str);
+
+/****************************************************************************
+* Definitions
+****************************************************************************/
+
+inline StringRef::StringRef()
+  : ptr(""), length(0)
+{
+}
+
+inline StringRef::StringRef(const char* str)
+  : ptr(str), length(std::strlen(str))
+{
+}
+
+inline StringRef::StringRef(const char* str, std::size_t length)
+  : ptr(str), length(length)
+{
+}
+
+inline StringRef::StringRef(const std::string& str)
+  : ptr(str.data()), length(str.size())
+{
+}
+
+inline char StringRef::operator[](std::size_t index) const
+{
+  assert(index < length);
+  return ptr[index];
+}
+
+inline const char* StringRef::data() const
+{
+  return ptr;
+}
+
+inline std::size_t StringRef::size() const
+{
+  return length;
+}
+
+inline bool StringRef::empty() const
+{
+  return length == 0;
+}
+
+inline const char* StringRef::begin() const
+{
+  return ptr;
+}
+
+inline const char* StringRef::end() const
+{
+  return ptr + length;
+}
+
+inline std::string StringRef::str() const
+{
+  return std::string(ptr, length);
+}
+
+inline int StringRef::compare(StringRef other) const
+{
+  auto common = length < other.length ? length : other.length;
+  int result = std::memcmp(ptr, other.ptr, common);
+  if (result != 0)
+  {
+    return result;
+  }
+  return length < other.length ? -1 : (length > other.length ? 1 : 0);
+}
+
+inline bool operator==(StringRef lhs, StringRef rhs)
+{
+  return lhs.size() == rhs.size() && 
+    std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+inline bool operator!=(StringRef lhs, StringRef rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator<(StringRef lhs, StringRef rhs)
+{
+  return lhs.compare(rhs) < 0;
+}
+
+inline std::string& operator+=(std::string& lhs, StringRef rhs)
+{
+  return lhs.append(rhs.data(), rhs.size());
+}
+
+inline std::ostream& operator<<(std::ostream& os, StringRef str)
+{
+  return os.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+}
+
+#endif
@@ -0,0 +1,441 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/AsyncLogQueue.h"
+#include <new>
+#include <type_traits>
+
+// Upper bound on how long the background thread sleeps without a wake up, 
+// only matters if a notification is missed.
+static const auto IDLE_WAIT = std::chrono::milliseconds(50);
+
+namespace util
+{
+
+static std::size_t roundUpPowerOfTwo(std::size_t value)
+{
+  std::size_t result = 2;
+  while (result < value)
+  {
+    result <<= 1;
+  }
+  return result;
+}
+
+AsyncLogQueue::AsyncLogQueue(std::size_t capacity, LogOverflowPolicy policy, 
+  Sink sink)
+  : slots(roundUpPowerOfTwo(capacity)),
+    mask(slots.size() - 1),
+    policy(policy),
+    sink(std::move(sink)),
+    enqueuePos(0),
+    enqueuePadding(),
+    dequeuePos(0),
+    dequeuePadding(),
+    droppedNewest(0),
+    droppedOldest(0),
+    sleeping(false),
+    blockedProducers(0),
+    stopping(false),
+    stopped(false),
+    flushRequested(0),
+    flushedPos(0),
+    worker()
+{
+  assert(this->sink);
+  for (std::size_t i = 0; i < slots.size(); i++)
+  {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  worker = std::thread(&AsyncLogQueue::run, this);
+}
+
+AsyncLogQueue::~AsyncLogQueue()
+{
+  shutdown();
+}
+
+bool AsyncLogQueue::push(LogLevel level, 
+  std::chrono::system_clock::time_point timeStamp, StringRef logName, 
+  StringRef tag, StringRef msg, const LogSource& source, LogFields fields)
+{
+  bool result = true;
+
+  switch (policy)
+  {
+  case LogOverflowPolicy::Block:
+    while (!tryPush(level, timeStamp, logName, tag, msg, source, fields))
+    {
+      waitForSpace();
+    }
+    break;
+
+  case LogOverflowPolicy::DropNewest:
+    if (!tryPush(level, timeStamp, logName, tag, msg, source, fields))
+    {
+      droppedNewest.fetch_add(1, std::memory_order_relaxed);
+      result = false;
+    }
+    break;
+
+  case LogOverflowPolicy::DropOldest:
+    if (!tryPush(level, timeStamp, logName, tag, msg, source, fields) && 
+      !(discardOldest() && 
+        tryPush(level, timeStamp, logName, tag, msg, source, fields)))
+    {
+      droppedNewest.fetch_add(1, std::memory_order_relaxed);
+      result = false;
+    }
+    break;
+  }
+
+  // pairs with the fence in run() so that either the producer sees the 
+  // sleeping flag or the consumer sees the new message
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping.load(std::memory_order_relaxed))
+  {
+    wake();
+  }
+  return result;
+}
+
+void AsyncLogQueue::flush()
+{
+  assert(std::this_thread::get_id() != worker.get_id());
+  std::unique_lock<std::mutex> lock(mutex);
+  if (stopping)
+  {
+    return;
+  }
+  // a message pushed before the call has claimed a position before this one, 
+  // even if its slot is not filled yet, so waiting for the background thread 
+  // to pass the position covers it
+  std::size_t target = enqueuePos.load(std::memory_order_acquire);
+  flushRequested++;
+  wakeCondition.notify_one();
+  flushCondition.wait(lock, [&] { return flushedPos >= target || stopped; });
+}
+
+void AsyncLogQueue::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    wakeCondition.notify_one();
+  }
+  if (worker.joinable())
+  {
+    worker.join();
+  }
+}
+
+std::size_t AsyncLogQueue::getCapacity() const
+{
+  return slots.size();
+}
+
+LogOverflowPolicy AsyncLogQueue::getPolicy() const
+{
+  return policy;
+}
+
+std::uint64_t AsyncLogQueue::getDroppedNewest() const
+{
+  return droppedNewest.load(std::memory_order_relaxed);
+}
+
+std::uint64_t AsyncLogQueue::getDroppedOldest() const
+{
+  return droppedOldest.load(std::memory_order_relaxed);
+}
+
+bool AsyncLogQueue::tryPush(LogLevel level, 
+  std::chrono::system_clock::time_point timeStamp, StringRef logName, 
+  StringRef tag, StringRef msg, const LogSource& source, LogFields fields)
+{
+  Slot* slot;
+  std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    slot = &slots[pos & mask];
+    std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::intptr_t>(seq) - 
+      static_cast<std::intptr_t>(pos);
+    if (diff == 0)
+    {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, 
+        std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      return false;
+    }
+    else
+    {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  // the slot strings keep their capacity, so once the queue has warmed up 
+  // these assignments do not allocate
+  slot->level = level;
+  slot->timeStamp = timeStamp;
+  slot->logName.assign(logName.data(), logName.size());
+  slot->tag.assign(tag.data(), tag.size());
+  slot->message.assign(msg.data(), msg.size());
+  slot->source = source;
+  copyFields(*slot, fields);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+void AsyncLogQueue::copyFields(Slot& slot, LogFields fields)
+{
+  slot.fields.clear();
+  slot.fieldText.clear();
+  if (fields.empty())
+  {
+    return;
+  }
+
+  // reserve the text up front so that appending never moves it, which 
+  // keeps the references of the fields copied so far valid
+  std::size_t length = 0;
+  for (const LogField& field : fields)
+  {
+    length += field.getKey().size();
+    if (field.getType() == LogFieldType::String)
+    {
+      length += field.getString().size();
+    }
+  }
+  slot.fieldText.reserve(length);
+
+  for (const LogField& field : fields)
+  {
+    StringRef key = field.getKey();
+    StringRef value = field.getType() == LogFieldType::String ? 
+      field.getString() : StringRef();
+    const char* text = slot.fieldText.data() + slot.fieldText.size();
+    slot.fieldText.append(key.data(), key.size());
+    slot.fieldText.append(value.data(), value.size());
+    slot.fields.push_back(field.rebind(StringRef(text, key.size()), 
+      StringRef(text + key.size(), value.size())));
+  }
+}
+
+AsyncLogQueue::Slot* AsyncLogQueue::tryAcquire(std::size_t& pos)
+{
+  Slot* slot;
+  pos = dequeuePos.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    slot = &slots[pos & mask];
+    std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::intptr_t>(seq) - 
+      static_cast<std::intptr_t>(pos + 1);
+    if (diff == 0)
+    {
+      if (dequeuePos.compare_exchange_weak(pos, pos + 1, 
+        std::memory_order_relaxed))
+      {
+        return slot;
+      }
+    }
+    else if (diff < 0)
+    {
+      return nullptr;
+    }
+    else
+    {
+      pos = dequeuePos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void AsyncLogQueue::release(Slot* slot, std::size_t pos)
+{
+  slot->sequence.store(pos + mask + 1, std::memory_order_release);
+}
+
+bool AsyncLogQueue::discardOldest()
+{
+  // when the background thread holds the slot the push needs, discarding 
+  // queued messages would not make room until the sink returns
+  std::size_t enqueue = enqueuePos.load(std::memory_order_relaxed);
+  std::size_t dequeue = dequeuePos.load(std::memory_order_relaxed);
+  if (enqueue - dequeue < slots.size())
+  {
+    return false;
+  }
+
+  std::size_t pos;
+  Slot* slot = tryAcquire(pos);
+  if (!slot)
+  {
+    return false;
+  }
+  release(slot, pos);
+  droppedOldest.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool AsyncLogQueue::hasPending() const
+{
+  std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+  const Slot& slot = slots[pos & mask];
+  return slot.sequence.load(std::memory_order_acquire) == pos + 1;
+}
+
+bool AsyncLogQueue::hasSpace() const
+{
+  std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+  const Slot& slot = slots[pos & mask];
+  auto diff = static_cast<std::intptr_t>(
+    slot.sequence.load(std::memory_order_acquire)) - 
+    static_cast<std::intptr_t>(pos);
+  // a slot ahead of the position means another producer has moved on
+  return diff >= 0;
+}
+
+void AsyncLogQueue::waitForSpace()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  // pairs with the fence in drain() so that either the producer sees the 
+  // released slot or the consumer sees the waiting producer
+  blockedProducers.fetch_add(1, std::memory_order_seq_cst);
+  // the background thread may be waiting for a slot that has been filled 
+  // since it last looked
+  wakeCondition.notify_one();
+  spaceCondition.wait_for(lock, IDLE_WAIT, [this] { return hasSpace(); });
+  blockedProducers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void AsyncLogQueue::wake()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  wakeCondition.notify_one();
+}
+
+void AsyncLogQueue::drain()
+{
+  using Storage = std::aligned_storage<sizeof(LogMessage), 
+    std::alignment_of<LogMessage>::value>::type;
+
+  Slot* batchSlots[MAX_BATCH];
+  std::size_t batchPos[MAX_BATCH];
+  Storage batchStorage[MAX_BATCH];
+  const LogMessage* batch[MAX_BATCH];
+
+  for (;;)
+  {
+    // claimed slots stay unavailable to the producers until the sink returns, 
+    // so the messages can refer to the slot strings without copying them
+    std::size_t count = 0;
+    while (count < MAX_BATCH)
+    {
+      Slot* slot = tryAcquire(batchPos[count]);
+      if (!slot)
+      {
+        break;
+      }
+      batchSlots[count] = slot;
+      batch[count] = new (&batchStorage[count]) LogMessage{
+        slot->level,
+        slot->timeStamp,
+        slot->logName,
+        slot->tag,
+        slot->message,
+        slot->source,
+        LogFields(slot->fields.data(), slot->fields.size())
+      };
+      count++;
+    }
+
+    if (count == 0)
+    {
+      return;
+    }
+
+    sink(batch, count);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+      batch[i]->~LogMessage();
+      release(batchSlots[i], batchPos[i]);
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (blockedProducers.load(std::memory_order_relaxed) > 0)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      spaceCondition.notify_all();
+    }
+  }
+}
+
+void AsyncLogQueue::run()
+{
+  for (;;)
+  {
+    std::uint64_t generation;
+    bool stop;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      generation = flushRequested;
+      stop = stopping;
+    }
+
+    drain();
+
+    // drain() stops at a slot that has been claimed but not yet filled, so 
+    // a flush may still be waiting for the messages behind it; the producer 
+    // filling the slot wakes this thread through the sleeping flag
+    std::size_t passed = dequeuePos.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (flushedPos != passed)
+    {
+      flushedPos = passed;
+      flushCondition.notify_all();
+    }
+    if (stop)
+    {
+      stopped = true;
+      flushCondition.notify_all();
+      break;
+    }
+
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!hasPending() && !stopping && flushRequested == generation)
+    {
+      wakeCondition.wait_for(lock, IDLE_WAIT);
+    }
+    sleeping.store(false, std::memory_order_relaxed);
+  }
+}
+
+}
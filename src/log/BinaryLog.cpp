@@ -0,0 +1,431 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/BinaryLog.h"
+#include <map>
+#include <tuple>
+
+// How often the background thread writes out the thread buffers when it is 
+// not asked to flush.
+static const auto WRITE_INTERVAL = std::chrono::milliseconds(10);
+
+// Identifies the start of a binary log stream.
+static const char STREAM_MAGIC[8] = { 'L', 'U', 'B', 'L', 'O', 'G', '0', '1' };
+
+namespace util
+{
+
+namespace
+{
+
+/**
+ * All of the call sites registered in the process.  Site ids are indexes 
+ * into the list, plus one.
+ */
+struct SiteRegistry
+{
+  // the compiler may merge identical format literals, so the argument types 
+  // are part of the key
+  using Key = std::tuple<const char*, LogLevel, std::string, 
+    std::vector<BinaryArgType>>;
+
+  std::mutex mutex;
+  std::vector<std::unique_ptr<BinaryLogSite>> sites;
+  std::map<Key, const BinaryLogSite*> index;
+};
+
+SiteRegistry& getSiteRegistry()
+{
+  static SiteRegistry registry;
+  return registry;
+}
+
+/**
+ * Buffers created by a thread, retired when the thread exits so that the 
+ * background thread of the log can release them once they are empty.
+ */
+struct ThreadBuffers
+{
+  std::vector<StrongPtr<BinaryLogBuffer>> buffers;
+
+  ~ThreadBuffers()
+  {
+    for (auto& buffer : buffers)
+    {
+      buffer->retire();
+    }
+  }
+};
+
+thread_local ThreadBuffers threadBuffers;
+
+std::atomic<std::uint64_t> nextLogId(1);
+
+template<typename T>
+void writeValue(std::ostream& out, const T& value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void writeString(std::ostream& out, StringRef str)
+{
+  writeValue(out, static_cast<std::uint32_t>(str.size()));
+  out.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+}
+
+thread_local BinaryLog::ThreadBufferCache BinaryLog::threadBufferCache = {
+  0, nullptr
+};
+
+BinaryLogBuffer::BinaryLogBuffer(std::size_t capacity, std::uint64_t logId)
+  : storage(capacity),
+    logId(logId),
+    producerPos(0),
+    endOfRecordedSpace(capacity),
+    minFreeSpace(capacity),
+    padding(),
+    consumerPos(0),
+    retired(false)
+{
+}
+
+std::uint64_t BinaryLogBuffer::getLogId() const
+{
+  return logId;
+}
+
+char* BinaryLogBuffer::reserveSlow(std::size_t size)
+{
+  const std::size_t capacity = storage.size();
+  if (size >= capacity)
+  {
+    return nullptr;
+  }
+
+  auto pos = producerPos.load(std::memory_order_relaxed);
+  while (minFreeSpace <= size)
+  {
+    auto consumed = consumerPos.load(std::memory_order_acquire);
+    if (consumed <= pos)
+    {
+      minFreeSpace = capacity - pos;
+      if (minFreeSpace > size)
+      {
+        break;
+      }
+
+      // not enough room at the end, so wrap around to the start unless that 
+      // would make the buffer look empty
+      if (consumed != 0)
+      {
+        endOfRecordedSpace = pos;
+        pos = 0;
+        producerPos.store(0, std::memory_order_release);
+        minFreeSpace = consumed;
+      }
+    }
+    else
+    {
+      minFreeSpace = consumed - pos;
+    }
+
+    if (minFreeSpace <= size)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  return storage.data() + pos;
+}
+
+const char* BinaryLogBuffer::peek(std::size_t& size)
+{
+  auto produced = producerPos.load(std::memory_order_acquire);
+  auto consumed = consumerPos.load(std::memory_order_relaxed);
+
+  if (produced < consumed)
+  {
+    size = endOfRecordedSpace - consumed;
+    if (size > 0)
+    {
+      return storage.data() + consumed;
+    }
+    consumed = 0;
+    consumerPos.store(0, std::memory_order_release);
+  }
+
+  size = produced - consumed;
+  return storage.data() + consumed;
+}
+
+void BinaryLogBuffer::consume(std::size_t size)
+{
+  consumerPos.store(consumerPos.load(std::memory_order_relaxed) + size, 
+    std::memory_order_release);
+}
+
+void BinaryLogBuffer::retire()
+{
+  retired.store(true, std::memory_order_release);
+}
+
+bool BinaryLogBuffer::isRetired() const
+{
+  return retired.load(std::memory_order_acquire);
+}
+
+BinaryLog::BinaryLog(const std::string& logName, std::ostream& output, 
+  std::size_t bufferSize, LogLevel outputLevel)
+  : logName(logName),
+    outputLevel(outputLevel),
+    output(output),
+    bufferSize(bufferSize),
+    logId(nextLogId.fetch_add(1)),
+    mutex(),
+    wakeCondition(),
+    flushCondition(),
+    buffers(),
+    sitesWritten(0),
+    flushRequested(0),
+    flushCompleted(0),
+    stopping(false),
+    dropped(0),
+    worker()
+{
+  assert(bufferSize > detail::BINARY_RECORD_HEADER_SIZE);
+  output.write(STREAM_MAGIC, sizeof(STREAM_MAGIC));
+  writeString(output, logName);
+  worker = std::thread(&BinaryLog::run, this);
+}
+
+BinaryLog::~BinaryLog()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    wakeCondition.notify_one();
+  }
+  worker.join();
+  output.flush();
+}
+
+const std::string& BinaryLog::getName() const
+{
+  return logName;
+}
+
+void BinaryLog::setLevel(LogLevel outputLevel)
+{
+  this->outputLevel.store(outputLevel, std::memory_order_relaxed);
+}
+
+LogLevel BinaryLog::getLevel() const
+{
+  return outputLevel.load(std::memory_order_relaxed);
+}
+
+bool BinaryLog::isActive(LogLevel level) const
+{
+  return getLevel() <= level;
+}
+
+void BinaryLog::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  auto generation = ++flushRequested;
+  wakeCondition.notify_one();
+  flushCondition.wait(lock, [&] { return flushCompleted >= generation; });
+}
+
+std::uint64_t BinaryLog::getDroppedCount() const
+{
+  return dropped.load(std::memory_order_relaxed);
+}
+
+const BinaryLogSite* BinaryLog::findSite(const char* format, LogLevel level, 
+  StringRef tag, const BinaryArgType* argTypes, std::size_t argCount)
+{
+  auto& registry = getSiteRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  SiteRegistry::Key key(format, level, tag.str(), 
+    std::vector<BinaryArgType>(argTypes, argTypes + argCount));
+  auto itr = registry.index.find(key);
+  if (itr != registry.index.end())
+  {
+    return itr->second;
+  }
+
+  std::unique_ptr<BinaryLogSite> site(new BinaryLogSite{
+    static_cast<std::uint32_t>(registry.sites.size() + 1),
+    level,
+    tag,
+    tag.str(),
+    format,
+    std::get<3>(key)
+  });
+  const BinaryLogSite* result = site.get();
+  registry.sites.push_back(std::move(site));
+  registry.index[key] = result;
+  return result;
+}
+
+BinaryLogBuffer* BinaryLog::findThreadBuffer()
+{
+  BinaryLogBuffer* buffer = nullptr;
+  for (auto& b : threadBuffers.buffers)
+  {
+    if (b->getLogId() == logId)
+    {
+      buffer = b.get();
+      break;
+    }
+  }
+
+  if (!buffer)
+  {
+    auto created = std::make_shared<BinaryLogBuffer>(bufferSize, logId);
+    threadBuffers.buffers.push_back(created);
+    buffer = created.get();
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.push_back(created);
+  }
+
+  threadBufferCache.logId = logId;
+  threadBufferCache.buffer = buffer;
+  return buffer;
+}
+
+void BinaryLog::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    auto generation = flushRequested;
+    bool stop = stopping;
+
+    lock.unlock();
+    drain();
+    output.flush();
+    lock.lock();
+
+    if (flushCompleted < generation)
+    {
+      flushCompleted = generation;
+      flushCondition.notify_all();
+    }
+    if (stop)
+    {
+      break;
+    }
+    if (!stopping && flushRequested == flushCompleted)
+    {
+      wakeCondition.wait_for(lock, WRITE_INTERVAL);
+    }
+  }
+}
+
+bool BinaryLog::drain()
+{
+  struct Pending
+  {
+    BinaryLogBuffer* buffer;
+    const char* data;
+    std::size_t size;
+  };
+
+  std::vector<StrongPtr<BinaryLogBuffer>> current;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = buffers;
+  }
+
+  // a buffer holds at most two contiguous blocks, one before and one after 
+  // the point where the producer wrapped around
+  bool wroteAny = false;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    std::vector<Pending> pending;
+    for (auto& buffer : current)
+    {
+      std::size_t size;
+      const char* data = buffer->peek(size);
+      if (size > 0)
+      {
+        pending.push_back(Pending{ buffer.get(), data, size });
+      }
+    }
+    if (pending.empty())
+    {
+      break;
+    }
+
+    // the sites are written after the records are peeked, so every site 
+    // used by a peeked record has already been registered
+    {
+      auto& registry = getSiteRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (; sitesWritten < registry.sites.size(); sitesWritten++)
+      {
+        const BinaryLogSite& site = *registry.sites[sitesWritten];
+        writeValue(output, detail::BinaryEntry::Site);
+        writeValue(output, site.id);
+        writeValue(output, site.level);
+        writeString(output, site.tag);
+        writeString(output, site.format);
+        writeValue(output, static_cast<std::uint8_t>(site.argTypes.size()));
+        for (auto type : site.argTypes)
+        {
+          writeValue(output, type);
+        }
+      }
+    }
+
+    for (auto& p : pending)
+    {
+      output.write(p.data, static_cast<std::streamsize>(p.size));
+      p.buffer->consume(p.size);
+    }
+    wroteAny = true;
+  }
+
+  // release buffers of threads that have exited once they are empty
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto itr = buffers.begin(); itr != buffers.end();)
+  {
+    std::size_t size;
+    if ((*itr)->isRetired() && ((*itr)->peek(size), size == 0))
+    {
+      itr = buffers.erase(itr);
+    }
+    else
+    {
+      ++itr;
+    }
+  }
+  return wroteAny;
+}
+
+}
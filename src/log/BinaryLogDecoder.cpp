@@ -0,0 +1,300 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/BinaryLogDecoder.h"
+
+namespace util
+{
+
+namespace
+{
+
+template<typename T>
+bool readValue(std::istream& in, T& value)
+{
+  return static_cast<bool>(
+    in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+bool readString(std::istream& in, std::string& str)
+{
+  std::uint32_t length;
+  if (!readValue(in, length))
+  {
+    return false;
+  }
+  str.resize(length);
+  return length == 0 || 
+    static_cast<bool>(in.read(&str[0], static_cast<std::streamsize>(length)));
+}
+
+}
+
+bool BinaryLogDecoder::decode(std::istream& in, const Sink& sink)
+{
+  sites.clear();
+  error.clear();
+
+  char magic[8];
+  if (!in.read(magic, sizeof(magic)) || 
+    std::memcmp(magic, "LUBLOG01", sizeof(magic)) != 0)
+  {
+    return fail("not a binary log stream");
+  }
+  if (!readString(in, logName))
+  {
+    return fail("truncated stream header");
+  }
+
+  for (;;)
+  {
+    detail::BinaryEntry entry;
+    if (!readValue(in, entry))
+    {
+      // a clean end of stream
+      return true;
+    }
+
+    bool ok;
+    switch (entry)
+    {
+    case detail::BinaryEntry::Site:
+      ok = readSite(in);
+      break;
+    case detail::BinaryEntry::Record:
+      ok = readRecord(in, sink);
+      break;
+    default:
+      ok = fail("unknown entry type");
+      break;
+    }
+
+    if (!ok)
+    {
+      return false;
+    }
+  }
+}
+
+bool BinaryLogDecoder::decode(std::istream& in, LogWriter& writer)
+{
+  return decode(in, [&](const LogMessage& msg) { writer.write(msg); });
+}
+
+const std::string& BinaryLogDecoder::getError() const
+{
+  return error;
+}
+
+bool BinaryLogDecoder::readSite(std::istream& in)
+{
+  std::uint32_t id;
+  Site site;
+  std::uint8_t argCount;
+  if (!readValue(in, id) || !readValue(in, site.level) || 
+    !readString(in, site.tag) || !readString(in, site.format) || 
+    !readValue(in, argCount))
+  {
+    return fail("truncated site description");
+  }
+
+  site.argTypes.resize(argCount);
+  for (auto& type : site.argTypes)
+  {
+    if (!readValue(in, type))
+    {
+      return fail("truncated site description");
+    }
+  }
+
+  sites[id] = std::move(site);
+  return true;
+}
+
+bool BinaryLogDecoder::readRecord(std::istream& in, const Sink& sink)
+{
+  std::uint32_t id;
+  std::int64_t timeStamp;
+  if (!readValue(in, id) || !readValue(in, timeStamp))
+  {
+    return fail("truncated record");
+  }
+
+  auto itr = sites.find(id);
+  if (itr == sites.end())
+  {
+    return fail("record refers to an unknown call site");
+  }
+  const Site& site = itr->second;
+
+  // the format was validated at compile time, so only the pieces need to 
+  // be found here
+  message.clear();
+  std::size_t arg = 0;
+  const std::string& fmt = site.format;
+  for (std::size_t i = 0; i < fmt.size(); i++)
+  {
+    char c = fmt[i];
+    if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c)
+    {
+      message.push_back(c);
+      i++;
+    }
+    else if (c == '{' && i + 1 < fmt.size() && fmt[i + 1] == '}')
+    {
+      if (arg >= site.argTypes.size() || 
+        !appendArg(in, site.argTypes[arg++]))
+      {
+        return fail("truncated record arguments");
+      }
+      i++;
+    }
+    else
+    {
+      message.push_back(c);
+    }
+  }
+
+  auto time = std::chrono::system_clock::time_point(
+    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::nanoseconds(timeStamp)));
+  sink(LogMessage{
+    site.level,
+    time,
+    logName,
+    site.tag,
+    message,
+    LogSource(),
+    LogFields()
+  });
+  return true;
+}
+
+bool BinaryLogDecoder::appendArg(std::istream& in, BinaryArgType type)
+{
+  switch (type)
+  {
+  case BinaryArgType::Bool:
+    {
+      std::uint8_t value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, value != 0);
+      return true;
+    }
+  case BinaryArgType::Char:
+    {
+      char value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, value);
+      return true;
+    }
+  case BinaryArgType::Int32:
+    {
+      std::int32_t value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, static_cast<long long>(value));
+      return true;
+    }
+  case BinaryArgType::UInt32:
+    {
+      std::uint32_t value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, static_cast<unsigned long long>(value));
+      return true;
+    }
+  case BinaryArgType::Int64:
+    {
+      std::int64_t value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, static_cast<long long>(value));
+      return true;
+    }
+  case BinaryArgType::UInt64:
+    {
+      std::uint64_t value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, static_cast<unsigned long long>(value));
+      return true;
+    }
+  case BinaryArgType::Double:
+    {
+      double value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, value);
+      return true;
+    }
+  case BinaryArgType::String:
+    {
+      std::uint32_t length;
+      if (!readValue(in, length))
+      {
+        return false;
+      }
+      auto start = message.size();
+      message.resize(start + length);
+      return length == 0 || static_cast<bool>(
+        in.read(&message[start], static_cast<std::streamsize>(length)));
+    }
+  case BinaryArgType::Pointer:
+    {
+      std::uint64_t value;
+      if (!readValue(in, value))
+      {
+        return false;
+      }
+      formatValue(message, reinterpret_cast<const void*>(
+        static_cast<std::uintptr_t>(value)));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool BinaryLogDecoder::fail(const std::string& reason)
+{
+  error = reason;
+  return false;
+}
+
+}
@@ -0,0 +1,109 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "log/BinaryRecordLogFormatter.h"
+#include <algorithm>
+
+namespace util
+{
+
+namespace
+{
+
+template<typename T>
+void appendValue(std::string& out, T value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void appendString(std::string& out, StringRef value)
+{
+  appendValue(out, static_cast<std::uint32_t>(value.size()));
+  out.append(value.data(), value.size());
+}
+
+void appendField(std::string& out, const LogField& field)
+{
+  appendString(out, field.getKey());
+  appendValue(out, static_cast<std::uint8_t>(field.getType()));
+  switch (field.getType())
+  {
+  case LogFieldType::Bool:
+    appendValue(out, static_cast<std::uint8_t>(field.getBool() ? 1 : 0));
+    break;
+
+  case LogFieldType::Int:
+    appendValue(out, static_cast<std::int64_t>(field.getInt()));
+    break;
+
+  case LogFieldType::UInt:
+    appendValue(out, static_cast<std::uint64_t>(field.getUInt()));
+    break;
+
+  case LogFieldType::Double:
+    appendValue(out, field.getDouble());
+    break;
+
+  case LogFieldType::String:
+    appendString(out, field.getString());
+    break;
+  }
+}
+
+}
+
+void BinaryRecordLogFormatter::append(const LogMessage& msg, 
+  std::string& out)
+{
+  // the size is filled in once the rest of the record has been written
+  std::size_t start = out.size();
+  appendValue(out, std::uint32_t(0));
+
+  auto timeStamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    msg.timeStamp.time_since_epoch()).count();
+  appendValue(out, static_cast<std::int64_t>(timeStamp));
+  appendValue(out, static_cast<std::uint8_t>(msg.level));
+  appendString(out, msg.logName);
+  appendString(out, msg.tag);
+  appendString(out, msg.message);
+  appendString(out, msg.source.file ? msg.source.file : "");
+  appendValue(out, static_cast<std::uint32_t>(msg.source.line));
+  appendString(out, msg.source.function ? msg.source.function : "");
+
+  std::size_t count = std::min<std::size_t>(msg.fields.size(), 
+    std::numeric_limits<std::uint16_t>::max());
+  appendValue(out, static_cast<std::uint16_t>(count));
+  for (std::size_t i = 0; i < count; i++)
+  {
+    appendField(out, msg.fields[i]);
+  }
+
+  auto size = static_cast<std::uint32_t>(out.size() - start - 4);
+  std::memcpy(&out[start], &size, sizeof(size));
+}
+
+StringRef BinaryRecordLogFormatter::getTerminator() const
+{
+  return StringRef();
+}
+
+}
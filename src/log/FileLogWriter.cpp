@@ -22,44 +22,304 @@
 */
 
 #include "log/FileLogWriter.h"
+#include "log/LogClock.h"
+#include "utility/Rcu.h"
+#include <cstdio>
+#include <ctime>
 
 namespace util
 {
 
-FileLogWriter::FileLogWriter(const std::string& filename, bool append)
+static bool fileExists(const std::string& path)
+{
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (file)
+  {
+    std::fclose(file);
+    return true;
+  }
+  return false;
+}
+
+FileLogWriter::FileLogWriter()
+  : filename(),
+    file(),
+    fileSize(0),
+    mapped(nullptr),
+    retired(),
+    hasRetired(false),
+    rotation(FileLogRotation{0, std::chrono::seconds(0), 0, false}),
+    rotateTime(0),
+    archiver(),
+    rotateMutex()
+{
+}
+
+FileLogWriter::FileLogWriter(const std::string& filename, bool append, 
+  FileLogMode mode)
   : FileLogWriter()
 {
-  open(filename, append);
+  open(filename, append, mode);
+}
+
+FileLogWriter::~FileLogWriter()
+{
+  flushRepeats();
+  close();
 }
 
-bool FileLogWriter::open(const std::string& filename, bool append)
+bool FileLogWriter::open(const std::string& filename, bool append, 
+  FileLogMode mode)
 {
   close();
 
   assert(!filename.empty());
-  auto mode = std::ios::out |
-    (append ? std::ios::app : std::ios::trunc);
-  file.open(filename.c_str(), mode);
-  return file.is_open();
+  if (mode == FileLogMode::Mapped)
+  {
+    std::unique_ptr<MappedLogFile> target(new MappedLogFile());
+    if (!target->open(filename, append))
+    {
+      return false;
+    }
+    mapped.store(target.release(), std::memory_order_release);
+  }
+  else
+  {
+    auto fileMode = std::ios::out |
+      (append ? std::ios::app : std::ios::trunc);
+    file.open(filename.c_str(), fileMode);
+    if (!file.is_open())
+    {
+      return false;
+    }
+    file.seekp(0, std::ios::end);
+    fileSize = static_cast<std::uint64_t>(file.tellp());
+  }
+
+  this->filename = filename;
+  resetRotateTime();
+  std::lock_guard<std::mutex> lock(rotateMutex);
+  startArchiver();
+  return true;
 }
 
 void FileLogWriter::close()
 {
+  std::lock_guard<std::mutex> lock(rotateMutex);
+
+  // nothing is being written, so the files can be closed without waiting
+  reclaim(true);
+  delete Rcu::assign(mapped, static_cast<MappedLogFile*>(nullptr));
   if (file.is_open())
   {
     file.close();
   }
+  fileSize = 0;
 }
 
 bool FileLogWriter::isOpen() const
 {
-  return file.is_open();
+  return mapped.load(std::memory_order_relaxed) != nullptr || file.is_open();
+}
+
+FileLogMode FileLogWriter::getMode() const
+{
+  return mapped.load(std::memory_order_relaxed) ? FileLogMode::Mapped : 
+    FileLogMode::Buffered;
+}
+
+void FileLogWriter::setRotation(const FileLogRotation& rotation)
+{
+  std::lock_guard<std::mutex> lock(rotateMutex);
+  this->rotation = rotation;
+  startArchiver();
+  resetRotateTime();
+}
+
+const FileLogRotation& FileLogWriter::getRotation() const
+{
+  return rotation;
+}
+
+bool FileLogWriter::rotate()
+{
+  std::lock_guard<std::mutex> lock(rotateMutex);
+  return rotateLocked();
+}
+
+void FileLogWriter::output(StringRef lines)
+{
+  std::uint64_t size;
+  {
+    Rcu::ReadLock lock;
+    MappedLogFile* target = Rcu::dereference(mapped);
+    if (target)
+    {
+      target->append(lines);
+      size = target->getSize();
+    }
+    else
+    {
+      assert(file.is_open());
+      // one flush per batch rather than one per line
+      file.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+      file.flush();
+      fileSize += lines.size();
+      size = fileSize;
+    }
+  }
+
+  if (isRotationDue(size) || hasRetired.load(std::memory_order_relaxed))
+  {
+    // one thread rotates while the others keep writing
+    std::unique_lock<std::mutex> lock(rotateMutex, std::try_to_lock);
+    if (lock.owns_lock())
+    {
+      if (isRotationDue(getFileSize()))
+      {
+        rotateLocked();
+      }
+      reclaim(false);
+    }
+  }
+}
+
+std::uint64_t FileLogWriter::getFileSize() const
+{
+  Rcu::ReadLock lock;
+  const MappedLogFile* target = Rcu::dereference(mapped);
+  return target ? target->getSize() : fileSize;
+}
+
+bool FileLogWriter::isRotationDue(std::uint64_t size) const
+{
+  if (rotation.maxSize > 0 && size >= rotation.maxSize)
+  {
+    return true;
+  }
+  return rotation.interval.count() > 0 && size > 0 && 
+    LogClock::now().time_since_epoch().count() >= 
+    rotateTime.load(std::memory_order_relaxed);
+}
+
+bool FileLogWriter::rotateLocked()
+{
+  if (!isOpen())
+  {
+    return false;
+  }
+
+  std::string segment = getSegmentName();
+  MappedLogFile* current = mapped.load(std::memory_order_relaxed);
+  if (current)
+  {
+    // the open file keeps being written under its new name until the new 
+    // file is published
+    if (std::rename(filename.c_str(), segment.c_str()) != 0)
+    {
+      return false;
+    }
+    std::unique_ptr<MappedLogFile> next(new MappedLogFile());
+    if (!next->open(filename, false))
+    {
+      std::rename(segment.c_str(), filename.c_str());
+      return false;
+    }
+
+    // appends that already hold the old file finish in it, it is closed and 
+    // archived once they are done
+    Rcu::assign(mapped, next.release());
+    retired.push_back(RetiredFile{current, segment, 
+      Rcu::startGracePeriod()});
+    hasRetired.store(true, std::memory_order_relaxed);
+  }
+  else
+  {
+    file.close();
+    bool renamed = std::rename(filename.c_str(), segment.c_str()) == 0;
+    auto fileMode = std::ios::out |
+      (renamed ? std::ios::trunc : std::ios::app);
+    file.open(filename.c_str(), fileMode);
+    if (!renamed)
+    {
+      return false;
+    }
+    fileSize = 0;
+    archive(segment);
+  }
+
+  resetRotateTime();
+  return true;
+}
+
+std::string FileLogWriter::getSegmentName() const
+{
+  std::time_t now = std::chrono::system_clock::to_time_t(
+    LogClock::now());
+  std::tm local;
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+  localtime_s(&local, &now);
+#else
+  localtime_r(&now, &local);
+#endif
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+  std::string base = filename + "." + stamp;
+  std::string name = base;
+  for (unsigned i = 1; fileExists(name) || fileExists(name + ".gz"); i++)
+  {
+    name = base + "-" + std::to_string(i);
+  }
+  return name;
+}
+
+void FileLogWriter::resetRotateTime()
+{
+  auto next = LogClock::now() + rotation.interval;
+  rotateTime.store(next.time_since_epoch().count(), 
+    std::memory_order_relaxed);
+}
+
+void FileLogWriter::startArchiver()
+{
+  // the old archiver finishes the files it was given first
+  archiver.reset();
+  if (isOpen() && rotation.maxFiles > 0)
+  {
+    archiver.reset(new LogArchiver(rotation.maxFiles, rotation.compress, 
+      filename));
+  }
+}
+
+void FileLogWriter::archive(const std::string& segment)
+{
+  if (!archiver)
+  {
+    archiver.reset(new LogArchiver(rotation.maxFiles, rotation.compress, 
+      filename));
+  }
+  archiver->add(segment);
 }
 
-void FileLogWriter::output(const std::string& msg)
+void FileLogWriter::reclaim(bool all)
 {
-  assert(file.is_open());
-  file << msg << std::endl;
+  auto it = retired.begin();
+  while (it != retired.end())
+  {
+    if (all || Rcu::hasElapsed(it->gracePeriod))
+    {
+      // closing truncates the file, so it is ready to be archived
+      delete it->file;
+      archive(it->segment);
+      it = retired.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  hasRetired.store(!retired.empty(), std::memory_order_relaxed);
 }
 
 }
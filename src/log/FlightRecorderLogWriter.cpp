@@ -0,0 +1,611 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "log/FlightRecorderLogWriter.h"
+#include "log/LogFormat.h"
+#include <algorithm>
+#include <csignal>
+#include <thread>
+
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace util
+{
+
+namespace
+{
+
+/**
+ * Rings created by a thread, retired when the thread exits.
+ */
+struct ThreadRings
+{
+  std::vector<StrongPtr<FlightRing>> rings;
+
+  ~ThreadRings()
+  {
+    for (auto& ring : rings)
+    {
+      ring->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+thread_local ThreadRings threadRings;
+
+std::atomic<std::uint64_t> nextRecorderId(1);
+
+/** The number of recorders that can be dumped from a signal handler. */
+const std::size_t MAX_SIGNAL_RECORDERS = 8;
+
+std::atomic<FlightRecorderLogWriter*> signalRecorders[MAX_SIGNAL_RECORDERS];
+
+const int FATAL_SIGNALS[] = {
+  SIGSEGV,
+#ifdef SIGBUS
+  SIGBUS,
+#endif
+  SIGFPE,
+  SIGILL,
+  SIGABRT
+};
+
+const std::size_t FATAL_SIGNAL_COUNT = 
+  sizeof(FATAL_SIGNALS) / sizeof(FATAL_SIGNALS[0]);
+
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+using SignalAction = void (*)(int);
+#else
+using SignalAction = struct sigaction;
+#endif
+
+SignalAction previousActions[FATAL_SIGNAL_COUNT];
+
+/** How long a signal handler waits for a thread to finish a record. */
+const int SIGNAL_SPIN_LIMIT = 1 << 20;
+
+/** Set once the signal handlers are installed. */
+std::atomic<bool> signalHandlersInstalled(false);
+
+#if LU_PLATFORM != LU_PLATFORM_WINDOWS
+/** The size of the stack the signal handlers run on. */
+const std::size_t SIGNAL_STACK_SIZE = 64 * 1024;
+
+/**
+ * An alternate stack for the signal handlers of a thread, so that a crash 
+ * caused by overflowing the thread's own stack can still be dumped.  Removed 
+ * when the thread exits.
+ */
+struct SignalStack
+{
+  std::vector<char> memory;
+
+  void install()
+  {
+    if (!memory.empty())
+    {
+      return;
+    }
+
+    stack_t current;
+    if (sigaltstack(nullptr, &current) != 0 || 
+      (current.ss_flags & SS_DISABLE) == 0)
+    {
+      return;
+    }
+
+    memory.resize(SIGNAL_STACK_SIZE);
+    stack_t stack;
+    std::memset(&stack, 0, sizeof(stack));
+    stack.ss_sp = memory.data();
+    stack.ss_size = memory.size();
+    if (sigaltstack(&stack, nullptr) != 0)
+    {
+      std::vector<char>().swap(memory);
+    }
+  }
+
+  ~SignalStack()
+  {
+    if (!memory.empty())
+    {
+      stack_t stack;
+      std::memset(&stack, 0, sizeof(stack));
+      stack.ss_flags = SS_DISABLE;
+      sigaltstack(&stack, nullptr);
+    }
+  }
+};
+
+thread_local SignalStack signalStack;
+#endif
+
+/**
+ * Sets up the alternate signal stack of the calling thread, if the signal 
+ * handlers are installed.
+ */
+void installSignalStack()
+{
+#if LU_PLATFORM != LU_PLATFORM_WINDOWS
+  if (signalHandlersInstalled.load(std::memory_order_acquire))
+  {
+    signalStack.install();
+  }
+#endif
+}
+
+/**
+ * Copies as much of a string as fits into a record.
+ */
+std::uint8_t copyText(StringRef text, std::size_t limit, char*& out, 
+  std::size_t& remaining)
+{
+  std::size_t size = std::min(std::min(text.size(), limit), remaining);
+  std::memcpy(out, text.data(), size);
+  out += size;
+  remaining -= size;
+  return static_cast<std::uint8_t>(size);
+}
+
+/**
+ * A fixed buffer for writing from a signal handler.
+ */
+struct SignalBuffer
+{
+  int fd;
+  std::size_t size;
+  char data[4096];
+
+  void flush()
+  {
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+    int result = _write(fd, data, static_cast<unsigned>(size));
+#else
+    ssize_t result = ::write(fd, data, size);
+#endif
+    LU_UNUSED(result);
+    size = 0;
+  }
+
+  void append(const char* text, std::size_t length)
+  {
+    while (length > 0)
+    {
+      if (size == sizeof(data))
+      {
+        flush();
+      }
+      std::size_t count = std::min(length, sizeof(data) - size);
+      std::memcpy(data + size, text, count);
+      size += count;
+      text += count;
+      length -= count;
+    }
+  }
+
+  void append(StringRef text)
+  {
+    append(text.data(), text.size());
+  }
+
+  void append(std::uint64_t value)
+  {
+    char digits[20];
+    std::size_t count = 0;
+    do
+    {
+      digits[sizeof(digits) - ++count] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value > 0);
+    append(digits + sizeof(digits) - count, count);
+  }
+};
+
+}
+
+thread_local FlightRecorderLogWriter::ThreadRingCache 
+  FlightRecorderLogWriter::threadRingCache = { 0, nullptr };
+
+FlightRing::FlightRing(std::uint64_t recorderId, std::size_t capacity)
+  : recorderId(recorderId),
+    records(capacity),
+    count(0),
+    writing(false),
+    dumping(false),
+    retired(false),
+    dumped(0)
+{
+}
+
+FlightRecorderLogWriter::FlightRecorderLogWriter(const std::string& filename, 
+  std::size_t recordsPerThread, LogLevel dumpLevel)
+  : recorderId(nextRecorderId.fetch_add(1)),
+    recordsPerThread(recordsPerThread),
+    dumpLevel(dumpLevel),
+    file(std::fopen(filename.c_str(), "ab")),
+    fd(-1),
+    ringMutex(),
+    ringsChanging(false),
+    rings(),
+    dumpMutex()
+{
+  assert(recordsPerThread > 0);
+  if (file)
+  {
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+    fd = _fileno(file);
+#else
+    fd = fileno(file);
+#endif
+  }
+  for (auto& recorder : signalRecorders)
+  {
+    FlightRecorderLogWriter* expected = nullptr;
+    if (recorder.compare_exchange_strong(expected, this))
+    {
+      break;
+    }
+  }
+}
+
+FlightRecorderLogWriter::~FlightRecorderLogWriter()
+{
+  for (auto& recorder : signalRecorders)
+  {
+    FlightRecorderLogWriter* expected = this;
+    recorder.compare_exchange_strong(expected, nullptr);
+  }
+
+  if (file)
+  {
+    std::fclose(file);
+  }
+}
+
+bool FlightRecorderLogWriter::isOpen() const
+{
+  return file != nullptr;
+}
+
+void FlightRecorderLogWriter::setDumpLevel(LogLevel level)
+{
+  dumpLevel.store(level, std::memory_order_relaxed);
+}
+
+LogLevel FlightRecorderLogWriter::getDumpLevel() const
+{
+  return dumpLevel.load(std::memory_order_relaxed);
+}
+
+std::size_t FlightRecorderLogWriter::dump()
+{
+  std::lock_guard<std::mutex> dumpLock(dumpMutex);
+
+  std::vector<StrongPtr<FlightRing>> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(ringMutex);
+    snapshot = rings;
+  }
+
+  std::vector<FlightRecord> records;
+  for (auto& ring : snapshot)
+  {
+    // pairs with record(), either the thread sees the dump and skips its 
+    // message, or the dump sees the thread writing and waits for it
+    ring->dumping.store(true);
+    while (ring->writing.load())
+    {
+      std::this_thread::yield();
+    }
+
+    std::uint64_t count = ring->count.load(std::memory_order_acquire);
+    std::uint64_t capacity = ring->records.size();
+    std::uint64_t first = std::max(ring->dumped, 
+      count > capacity ? count - capacity : 0);
+    for (std::uint64_t i = first; i < count; i++)
+    {
+      records.push_back(ring->records[i % capacity]);
+    }
+    ring->dumped = count;
+    ring->dumping.store(false, std::memory_order_release);
+  }
+
+  if (records.empty())
+  {
+    return 0;
+  }
+
+  std::stable_sort(records.begin(), records.end(), 
+    [](const FlightRecord& lhs, const FlightRecord& rhs)
+    {
+      return lhs.timeStamp < rhs.timeStamp;
+    });
+
+  auto& formatter = getFormatter();
+  assert(formatter != nullptr);
+  StringRef terminator = formatter->getTerminator();
+  ScopedLogBuffer buffer;
+  std::string& lines = buffer.get();
+  for (const FlightRecord& record : records)
+  {
+    const char* text = record.text;
+    StringRef logName(text, record.logNameSize);
+    text += record.logNameSize;
+    StringRef tag(text, record.tagSize);
+    text += record.tagSize;
+    StringRef message(text, record.messageSize);
+
+    LogMessage msg{
+      record.level,
+      std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::nanoseconds(record.timeStamp))),
+      logName,
+      tag,
+      message,
+      LogSource{record.file, record.line, record.function},
+      LogFields()
+    };
+    formatter->append(msg, lines);
+    lines.append(terminator.data(), terminator.size());
+  }
+  output(lines);
+  return records.size();
+}
+
+void FlightRecorderLogWriter::installSignalHandlers()
+{
+  signalHandlersInstalled.store(true, std::memory_order_release);
+  installSignalStack();
+  for (std::size_t i = 0; i < FATAL_SIGNAL_COUNT; i++)
+  {
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+    previousActions[i] = std::signal(FATAL_SIGNALS[i], &handleSignal);
+#else
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &handleSignal;
+    action.sa_flags = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    sigaction(FATAL_SIGNALS[i], &action, &previousActions[i]);
+#endif
+  }
+}
+
+void FlightRecorderLogWriter::prepare(LogFormatCache& cache)
+{
+  LU_UNUSED(cache);
+}
+
+void FlightRecorderLogWriter::write(LogFormatCache& cache)
+{
+  LogLevel trigger = getDumpLevel();
+  bool shouldDump = false;
+  for (std::size_t i = 0; i < cache.getCount(); i++)
+  {
+    const LogMessage& msg = cache.getMessage(i);
+    if (isActive(msg.level))
+    {
+      record(msg);
+      shouldDump = shouldDump || msg.level >= trigger;
+    }
+  }
+
+  if (shouldDump && trigger != LogLevel::None)
+  {
+    dump();
+  }
+}
+
+void FlightRecorderLogWriter::output(StringRef lines)
+{
+  if (file)
+  {
+    std::fwrite(lines.data(), 1, lines.size(), file);
+    std::fflush(file);
+  }
+}
+
+void FlightRecorderLogWriter::record(const LogMessage& msg)
+{
+  FlightRing* ring = getThreadRing();
+  ring->writing.store(true);
+  if (ring->dumping.load())
+  {
+    ring->writing.store(false, std::memory_order_release);
+    return;
+  }
+
+  std::uint64_t count = ring->count.load(std::memory_order_relaxed);
+  FlightRecord& record = ring->records[count % ring->records.size()];
+  record.timeStamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    msg.timeStamp.time_since_epoch()).count();
+  record.file = msg.source.file;
+  record.function = msg.source.function;
+  record.line = msg.source.line;
+  record.level = msg.level;
+
+  // the names are kept short so that most of the record holds the message
+  char* out = record.text;
+  std::size_t remaining = FlightRecord::TEXT_SIZE;
+  record.logNameSize = copyText(msg.logName, 32, out, remaining);
+  record.tagSize = copyText(msg.tag, 32, out, remaining);
+  record.messageSize = copyText(msg.message, 255, out, remaining);
+
+  ring->count.store(count + 1, std::memory_order_release);
+  ring->writing.store(false, std::memory_order_release);
+}
+
+FlightRing* FlightRecorderLogWriter::findThreadRing()
+{
+  FlightRing* ring = nullptr;
+  auto& owned = threadRings.rings;
+  for (auto itr = owned.begin(); itr != owned.end();)
+  {
+    if ((*itr)->recorderId == recorderId)
+    {
+      ring = itr->get();
+      ++itr;
+    }
+    else if (itr->use_count() == 1)
+    {
+      // the recorder of the ring is gone
+      itr = owned.erase(itr);
+    }
+    else
+    {
+      ++itr;
+    }
+  }
+
+  if (!ring)
+  {
+    installSignalStack();
+    auto created = std::make_shared<FlightRing>(recorderId, 
+      recordsPerThread);
+    owned.push_back(created);
+    ring = created.get();
+
+    std::lock_guard<std::mutex> lock(ringMutex);
+    // only a signal handler reading the list can hold the flag, and it 
+    // never waits
+    while (ringsChanging.exchange(true, std::memory_order_acquire))
+    {
+      std::this_thread::yield();
+    }
+    rings.push_back(created);
+
+    // forget the oldest rings of exited threads beyond the limit
+    auto retired = static_cast<std::size_t>(std::count_if(rings.begin(), 
+      rings.end(), [](const StrongPtr<FlightRing>& r)
+      {
+        return r->retired.load(std::memory_order_acquire);
+      }));
+    for (auto itr = rings.begin(); 
+      retired > MAX_RETIRED_RINGS && itr != rings.end();)
+    {
+      if ((*itr)->retired.load(std::memory_order_acquire))
+      {
+        itr = rings.erase(itr);
+        retired--;
+      }
+      else
+      {
+        ++itr;
+      }
+    }
+    ringsChanging.store(false, std::memory_order_release);
+  }
+
+  threadRingCache.recorderId = recorderId;
+  threadRingCache.ring = ring;
+  return ring;
+}
+
+void FlightRecorderLogWriter::dumpFromSignal()
+{
+  // the list may be being changed by the interrupted thread, in which case 
+  // it can not be read safely
+  if (fd < 0 || ringsChanging.exchange(true, std::memory_order_acquire))
+  {
+    return;
+  }
+
+  SignalBuffer buffer;
+  buffer.fd = fd;
+  buffer.size = 0;
+
+  for (auto& ring : rings)
+  {
+    ring->dumping.store(true);
+    for (int i = 0; i < SIGNAL_SPIN_LIMIT && ring->writing.load(); i++)
+    {
+    }
+
+    std::uint64_t count = ring->count.load(std::memory_order_acquire);
+    std::uint64_t capacity = ring->records.size();
+    std::uint64_t first = count > capacity ? count - capacity : 0;
+    buffer.append("--- thread ring ");
+    buffer.append(static_cast<std::uint64_t>(&ring - rings.data()));
+    buffer.append(" ---\n");
+    for (std::uint64_t i = first; i < count; i++)
+    {
+      const FlightRecord& record = ring->records[i % capacity];
+      const char* text = record.text;
+      buffer.append(static_cast<std::uint64_t>(record.timeStamp));
+      buffer.append(" ");
+      buffer.append(getLevelName(record.level));
+      buffer.append(" [");
+      buffer.append(text, record.logNameSize);
+      text += record.logNameSize;
+      buffer.append("] ");
+      buffer.append(text, record.tagSize);
+      text += record.tagSize;
+      buffer.append(": ");
+      buffer.append(text, record.messageSize);
+      if (record.file)
+      {
+        buffer.append(" (");
+        buffer.append(record.file);
+        buffer.append(":");
+        buffer.append(static_cast<std::uint64_t>(record.line));
+        buffer.append(")");
+      }
+      buffer.append("\n");
+    }
+  }
+  buffer.flush();
+  ringsChanging.store(false, std::memory_order_release);
+}
+
+void FlightRecorderLogWriter::handleSignal(int signal)
+{
+  for (auto& recorder : signalRecorders)
+  {
+    FlightRecorderLogWriter* current = recorder.load();
+    if (current)
+    {
+      current->dumpFromSignal();
+    }
+  }
+
+  // restore the previous handling, which runs once the signal is raised 
+  // again after this handler returns
+  for (std::size_t i = 0; i < FATAL_SIGNAL_COUNT; i++)
+  {
+    if (FATAL_SIGNALS[i] == signal)
+    {
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+      std::signal(signal, previousActions[i]);
+#else
+      sigaction(signal, &previousActions[i], nullptr);
+#endif
+    }
+  }
+  std::raise(signal);
+}
+
+}
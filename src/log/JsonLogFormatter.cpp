@@ -0,0 +1,166 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "log/JsonLogFormatter.h"
+#include "log/LogFormat.h"
+#include <cmath>
+
+namespace util
+{
+
+namespace
+{
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+void appendMember(StringRef key, std::string& out)
+{
+  out.push_back(',');
+  JsonLogFormatter::appendString(key, out);
+  out.push_back(':');
+}
+
+void appendField(const LogField& field, std::string& out)
+{
+  appendMember(field.getKey(), out);
+  switch (field.getType())
+  {
+  case LogFieldType::Bool:
+    out += field.getBool() ? "true" : "false";
+    break;
+
+  case LogFieldType::Int:
+    formatValue(out, field.getInt());
+    break;
+
+  case LogFieldType::UInt:
+    formatValue(out, field.getUInt());
+    break;
+
+  case LogFieldType::Double:
+    {
+      double value = field.getDouble();
+      if (!std::isfinite(value))
+      {
+        out += "null";
+        break;
+      }
+
+      // enough digits for the value to be read back exactly
+      char buffer[32];
+      int length = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+      assert(length > 0 && length < static_cast<int>(sizeof(buffer)));
+      out.append(buffer, static_cast<std::size_t>(length));
+    }
+    break;
+
+  case LogFieldType::String:
+    JsonLogFormatter::appendString(field.getString(), out);
+    break;
+  }
+}
+
+}
+
+void JsonLogFormatter::append(const LogMessage& msg, std::string& out)
+{
+  auto timeStamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    msg.timeStamp.time_since_epoch()).count();
+
+  out += "{\"ts\":";
+  formatValue(out, static_cast<long long>(timeStamp));
+  appendMember("level", out);
+  appendString(getLevelName(msg.level), out);
+  appendMember("log", out);
+  appendString(msg.logName, out);
+  appendMember("tag", out);
+  appendString(msg.tag, out);
+  appendMember("msg", out);
+  appendString(msg.message, out);
+
+  if (msg.source.file)
+  {
+    appendMember("file", out);
+    appendString(msg.source.file, out);
+    appendMember("line", out);
+    formatValue(out, msg.source.line);
+  }
+  if (msg.source.function)
+  {
+    appendMember("func", out);
+    appendString(msg.source.function, out);
+  }
+
+  for (const LogField& field : msg.fields)
+  {
+    appendField(field, out);
+  }
+  out.push_back('}');
+}
+
+void JsonLogFormatter::appendString(StringRef value, std::string& out)
+{
+  out.push_back('"');
+
+  // copy runs of characters that need no escaping in one go
+  const char* run = value.data();
+  const char* end = value.data() + value.size();
+  for (const char* pos = run; pos != end; pos++)
+  {
+    auto c = static_cast<unsigned char>(*pos);
+    if (c >= 0x20 && c != '"' && c != '\\')
+    {
+      continue;
+    }
+
+    out.append(run, pos);
+    run = pos + 1;
+    switch (c)
+    {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      out += "\\u00";
+      out.push_back(HEX_DIGITS[c >> 4]);
+      out.push_back(HEX_DIGITS[c & 0xf]);
+      break;
+    }
+  }
+  out.append(run, end);
+
+  out.push_back('"');
+}
+
+}
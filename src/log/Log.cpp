@@ -22,21 +22,60 @@
 */
 
 #include "log/Log.h"
+#include "log/LogClock.h"
 #include <cstdio>
 
-// The printf style log functions use a fixed size stack buffer to process the 
-// format string.
+// The printf style log functions first format into a stack buffer of this 
+// size, and only fall back to the thread's growable buffer for longer output.
 static const int PRINTF_BUFFER_SIZE = 256;
 
 namespace util
 {
 
+Log::Log(const Log& other)
+  : logName(other.logName),
+    outputLevel(other.getLevel()),
+    writers(std::make_shared<LogWriterSet>(*other.writers)),
+    asyncQueue()
+{}
+
 Log::Log(const std::string& logName, LogLevel outputLevel)
   : logName(logName),
     outputLevel(outputLevel),
-    writers()
+    writers(std::make_shared<LogWriterSet>()),
+    asyncQueue()
 {}
 
+Log::Log(const std::string& logName, StrongPtr<LogWriterSet> writers, 
+  LogLevel outputLevel)
+  : logName(logName),
+    outputLevel(outputLevel),
+    writers(writers),
+    asyncQueue()
+{
+  assert(this->writers != nullptr);
+}
+
+Log::~Log()
+{
+  disableAsync();
+  // the writers cannot output from their own destructors, so runs of 
+  // repeats still being counted are written here
+  writers->forEach([](LogWriter& writer) { writer.flushRepeats(); });
+}
+
+Log& Log::operator=(const Log& other)
+{
+  if (this != &other)
+  {
+    disableAsync();
+    logName = other.logName;
+    setLevel(other.getLevel());
+    writers = std::make_shared<LogWriterSet>(*other.writers);
+  }
+  return *this;
+}
+
 void Log::setName(const std::string& logName)
 {
   this->logName = logName;
@@ -49,57 +88,84 @@ const std::string& Log::getName() const
 
 void Log::setLevel(LogLevel outputLevel)
 {
-  this->outputLevel = outputLevel;
+  this->outputLevel.store(outputLevel, std::memory_order_relaxed);
 }
 
 LogLevel Log::getLevel() const
 {
-  return outputLevel;
+  return outputLevel.load(std::memory_order_relaxed);
 }
 
-bool Log::isActive(LogLevel level) const
+bool Log::hasWriter(const std::string& name) const
 {
-  return outputLevel <= level;
+  return writers->has(name);
 }
 
-bool Log::hasWriter(const std::string& name) const
+bool Log::addWriter(const std::string& name, StrongLogWriterPtr writer)
 {
-  return writers.find(name) != writers.end();
+  return writers->add(name, writer);
 }
 
-bool Log::addWriter(const std::string& name, StrongLogWriterPtr writer)
+bool Log::removeWriter(const std::string& name)
+{
+  return writers->remove(name);
+}
+
+void Log::enableAsync(std::size_t capacity, LogOverflowPolicy policy)
 {
-  assert(writer != nullptr);
-  if (hasWriter(name))
+  assert(capacity > 0);
+  disableAsync();
+  asyncQueue.reset(new AsyncLogQueue(capacity, policy, 
+    [this](const LogMessage* const* msgs, std::size_t count) 
+    {
+      write(msgs, count);
+    }));
+}
+
+void Log::disableAsync()
+{
+  if (asyncQueue)
   {
-    return false;
+    asyncQueue->shutdown();
+    asyncQueue.reset();
   }
-  writers[name] = writer;
-  return true;
 }
 
-bool Log::removeWriter(const std::string& name)
+bool Log::isAsync() const
 {
-  auto itr = writers.find(name);
-  if (itr == writers.end())
+  return asyncQueue != nullptr;
+}
+
+void Log::flush()
+{
+  if (asyncQueue)
   {
-    return false;
+    asyncQueue->flush();
   }
-  writers.erase(itr);
-  return true;
+  writers->forEach([](LogWriter& writer) { writer.flushExpiredRepeats(); });
+}
+
+std::uint64_t Log::getDroppedNewest() const
+{
+  return asyncQueue ? asyncQueue->getDroppedNewest() : 0;
+}
+
+std::uint64_t Log::getDroppedOldest() const
+{
+  return asyncQueue ? asyncQueue->getDroppedOldest() : 0;
 }
 
-Log::StreamHelper Log::info(const std::string& tag)
+Log::StreamHelper Log::info(StringRef tag)
 {
   return stream(LogLevel::Info, tag);
 }
 
-void Log::info(const std::string& tag, const std::string& msg)
+void Log::info(StringRef tag, StringRef msg)
 {
   log(LogLevel::Info, tag, msg);
 }
 
-void Log::infof(const std::string& tag, const char* fmt, ...)
+void Log::infof(StringRef tag, const char* fmt, ...)
 {
   va_list args;
   va_start(args, fmt);
@@ -107,17 +173,17 @@ void Log::infof(const std::string& tag, const char* fmt, ...)
   va_end(args);
 }
 
-Log::StreamHelper Log::warning(const std::string& tag)
+Log::StreamHelper Log::warning(StringRef tag)
 {
   return stream(LogLevel::Warning, tag);
 }
 
-void Log::warning(const std::string& tag, const std::string& msg)
+void Log::warning(StringRef tag, StringRef msg)
 {
   log(LogLevel::Warning, tag, msg);
 }
 
-void Log::warningf(const std::string& tag, const char* fmt, ...)
+void Log::warningf(StringRef tag, const char* fmt, ...)
 {
   va_list args;
   va_start(args, fmt);
@@ -125,17 +191,17 @@ void Log::warningf(const std::string& tag, const char* fmt, ...)
   va_end(args);
 }
 
-Log::StreamHelper Log::error(const std::string& tag)
+Log::StreamHelper Log::error(StringRef tag)
 {
   return stream(LogLevel::Error, tag);
 }
 
-void Log::error(const std::string& tag, const std::string& msg)
+void Log::error(StringRef tag, StringRef msg)
 {
   log(LogLevel::Error, tag, msg);
 }
 
-void Log::errorf(const std::string& tag, const char* fmt, ...)
+void Log::errorf(StringRef tag, const char* fmt, ...)
 {
   va_list args;
   va_start(args, fmt);
@@ -143,7 +209,7 @@ void Log::errorf(const std::string& tag, const char* fmt, ...)
   va_end(args);
 }
 
-void Log::log(LogLevel level, const std::string& tag, const std::string& msg)
+void Log::log(LogLevel level, StringRef tag, StringRef msg)
 {
   if (isActive(level))
   {
@@ -151,7 +217,7 @@ void Log::log(LogLevel level, const std::string& tag, const std::string& msg)
   }
 }
 
-void Log::logf(LogLevel level, const std::string& tag, const char* fmt, ...)
+void Log::logf(LogLevel level, StringRef tag, const char* fmt, ...)
 {
   va_list args;
   va_start(args, fmt);
@@ -159,7 +225,7 @@ void Log::logf(LogLevel level, const std::string& tag, const char* fmt, ...)
   va_end(args);
 }
 
-void Log::logv(LogLevel level, const std::string& tag, const char* fmt, 
+void Log::logv(LogLevel level, StringRef tag, const char* fmt, 
   va_list args)
 {
   if (!isActive(level))
@@ -168,91 +234,218 @@ void Log::logv(LogLevel level, const std::string& tag, const char* fmt,
   }
 
   char buffer[PRINTF_BUFFER_SIZE];
-  int result = vsnprintf(buffer, PRINTF_BUFFER_SIZE, fmt, args);
-  std::string msg;
+  va_list copy;
+  va_copy(copy, args);
 
   // as of msvc 2013 microsoft's vsnprintf has a non-standard return value,
-  // it only signals when the buffer is too small
+  // it only signals when the buffer is too small, so measure the output 
+  // separately
 #if LU_COMPILER == LU_COMPILER_MSVC
-  if (result == -1)
+  int result = _vscprintf(fmt, copy);
+  if (result >= 0 && result < PRINTF_BUFFER_SIZE)
   {
-    buffer[PRINTF_BUFFER_SIZE - 1] = '\0';
-    msg = std::string(buffer).append("...");
+    vsnprintf(buffer, PRINTF_BUFFER_SIZE, fmt, args);
   }
 #else
-  if (result == -1)
+  int result = vsnprintf(buffer, PRINTF_BUFFER_SIZE, fmt, copy);
+#endif
+  va_end(copy);
+
+  if (result < 0)
   {
-    msg = std::string("vsnprintf error in Log::logv");
+    dispatch(level, tag, "vsnprintf error in Log::logv");
+    return;
   }
-  else if (result >= PRINTF_BUFFER_SIZE)
+
+  auto length = static_cast<std::size_t>(result);
+  if (result < PRINTF_BUFFER_SIZE)
   {
-    buffer[PRINTF_BUFFER_SIZE - 1] = '\0';
-    msg = std::string(buffer).append("...");
+    dispatch(level, tag, StringRef(buffer, length));
+    return;
   }
-#endif
-  else
+
+  // the null terminator is written into the string's own terminator slot
+  ScopedLogBuffer longBuffer;
+  std::string& msg = longBuffer.get();
+  msg.resize(length);
+  vsnprintf(&msg[0], length + 1, fmt, args);
+  dispatch(level, tag, msg);
+}
+
+Log::StreamHelper Log::stream(LogLevel level, StringRef tag)
+{
+  return StreamHelper(*this, level, tag, LogSource(), isActive(level));
+}
+
+Log::StreamHelper Log::stream(LogLevel level, StringRef tag, 
+  const LogSource& source)
+{
+  return StreamHelper(*this, level, tag, source, isActive(level));
+}
+
+Log::StreamHelper Log::info(const LogTag& tag)
+{
+  return stream(LogLevel::Info, tag);
+}
+
+void Log::info(const LogTag& tag, StringRef msg)
+{
+  log(LogLevel::Info, tag, msg);
+}
+
+Log::StreamHelper Log::warning(const LogTag& tag)
+{
+  return stream(LogLevel::Warning, tag);
+}
+
+void Log::warning(const LogTag& tag, StringRef msg)
+{
+  log(LogLevel::Warning, tag, msg);
+}
+
+Log::StreamHelper Log::error(const LogTag& tag)
+{
+  return stream(LogLevel::Error, tag);
+}
+
+void Log::error(const LogTag& tag, StringRef msg)
+{
+  log(LogLevel::Error, tag, msg);
+}
+
+void Log::log(LogLevel level, const LogTag& tag, StringRef msg)
+{
+  if (isActive(level, tag))
   {
-    msg = std::string(buffer);
+    dispatch(level, tag.getName(), msg);
   }
+}
 
-  dispatch(level, tag, msg);
+Log::StreamHelper Log::stream(LogLevel level, const LogTag& tag)
+{
+  return StreamHelper(*this, level, tag.getName(), LogSource(), 
+    isActive(level, tag));
+}
+
+Log::StreamHelper Log::stream(LogLevel level, const LogTag& tag, 
+  const LogSource& source)
+{
+  return StreamHelper(*this, level, tag.getName(), source, 
+    isActive(level, tag));
+}
+
+void Log::info(StringRef tag, StringRef msg, LogFields fields)
+{
+  log(LogLevel::Info, tag, msg, fields);
+}
+
+void Log::warning(StringRef tag, StringRef msg, LogFields fields)
+{
+  log(LogLevel::Warning, tag, msg, fields);
+}
+
+void Log::error(StringRef tag, StringRef msg, LogFields fields)
+{
+  log(LogLevel::Error, tag, msg, fields);
+}
+
+void Log::log(LogLevel level, StringRef tag, StringRef msg, LogFields fields)
+{
+  if (isActive(level))
+  {
+    dispatch(level, tag, msg, LogSource(), fields);
+  }
 }
 
-Log::StreamHelper Log::stream(LogLevel level, const std::string& tag)
+void Log::log(LogLevel level, const LogTag& tag, StringRef msg, 
+  LogFields fields)
 {
-  return StreamHelper(*this, level, tag);
+  if (isActive(level, tag))
+  {
+    dispatch(level, tag.getName(), msg, LogSource(), fields);
+  }
 }
 
-void Log::dispatch(LogLevel level, const std::string& tag, 
-  const std::string& msg)
+void Log::dispatch(LogLevel level, StringRef tag, StringRef msg, 
+  const LogSource& source, LogFields fields)
 {
-  StrongLogMessagePtr lm(new LogMessage{
+  auto timeStamp = LogClock::now();
+
+  if (asyncQueue)
+  {
+    asyncQueue->push(level, timeStamp, logName, tag, msg, source, fields);
+    return;
+  }
+
+  write(LogMessage{
     level,
-    std::chrono::system_clock::now(),
+    timeStamp,
     logName,
     tag,
-    msg
-    }
-  );
+    msg,
+    source,
+    fields
+  });
+}
 
-  for (auto writer : writers)
-  {
-    writer.second->write(lm);
-  }
+void Log::write(const LogMessage& msg)
+{
+  const LogMessage* msgs[] = { &msg };
+  write(msgs, 1);
 }
 
-Log::StreamHelper::StreamHelper(Log& log, LogLevel level, 
-  const std::string& tag)
-  : impl(new StreamHelperImpl(log, level, tag))
+void Log::write(const LogMessage* const* msgs, std::size_t count)
 {
+  // writers that share a formatter share the formatted text, which covers 
+  // the levels of all of them and no others
+  LogFormatCache cache(msgs, count);
+  writers->forEach([&](LogWriter& writer) { writer.prepare(cache); });
+  writers->forEach([&](LogWriter& writer) { writer.write(cache); });
 }
 
-Log::StreamHelper& Log::StreamHelper::operator<<(
-  Log::StreamHelper::Manipulator manip)
+Log::StreamHelper::StreamHelper(Log& log, LogLevel level, StringRef tag, 
+  const LogSource& source, bool active)
+  : log(&log),
+    level(level),
+    tag(tag),
+    source(source),
+    buffer(active ? &LogStreamBuffer::acquire() : nullptr)
 {
-  manip(impl->os);
-  return *this;
 }
 
+Log::StreamHelper::StreamHelper(StreamHelper&& other)
+  : log(other.log),
+    level(other.level),
+    tag(other.tag),
+    source(other.source),
+    buffer(other.buffer)
+{
+  other.buffer = nullptr;
+}
 
-Log::DummyStreamHelper& Log::DummyStreamHelper::operator<<(Manipulator manip)
+Log::StreamHelper::~StreamHelper()
 {
-  LU_UNUSED(manip);
-  return *this;
+  if (buffer)
+  {
+    log->dispatch(level, tag, buffer->str(), source);
+    LogStreamBuffer::release(*buffer);
+  }
 }
 
-Log::StreamHelperImpl::StreamHelperImpl(Log& log, LogLevel level, 
-  const std::string& tag) 
-: log(log),
-  level(level),
-  tag(tag),
-  os()
+Log::StreamHelper& Log::StreamHelper::operator<<(
+  Log::StreamHelper::Manipulator manip)
 {
+  if (buffer)
+  {
+    manip(buffer->stream);
+  }
+  return *this;
 }
 
-Log::StreamHelperImpl::~StreamHelperImpl()
+Log::DummyStreamHelper& Log::DummyStreamHelper::operator<<(Manipulator manip)
 {
-  log.log(level, tag, os.str());
+  LU_UNUSED(manip);
+  return *this;
 }
 
 }
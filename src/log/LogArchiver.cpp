@@ -0,0 +1,325 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/LogArchiver.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <tuple>
+
+#ifdef LU_LOG_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace util
+{
+
+namespace
+{
+
+/** The length of the YYYYMMDD-HHMMSS stamp of a segment name. */
+const std::size_t STAMP_LENGTH = 15;
+
+/**
+ * A segment found on disk, ordered by when it was rotated.
+ */
+struct Segment
+{
+  std::string stamp;
+  unsigned long counter;
+  std::string path;
+
+  bool operator<(const Segment& other) const
+  {
+    return std::tie(stamp, counter, path) < 
+      std::tie(other.stamp, other.counter, other.path);
+  }
+};
+
+bool isDigits(const std::string& text, std::size_t begin, std::size_t end)
+{
+  if (begin >= end)
+  {
+    return false;
+  }
+  for (std::size_t i = begin; i < end; i++)
+  {
+    if (text[i] < '0' || text[i] > '9')
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Parses the part of a segment name after "<file>.", which is the stamp, 
+ * an optional "-N" counter, and an optional ".gz" suffix.
+ */
+bool parseSegment(const std::string& suffix, Segment& segment)
+{
+  std::size_t end = suffix.size();
+  if (end > 3 && suffix.compare(end - 3, 3, ".gz") == 0)
+  {
+    end -= 3;
+  }
+  if (end < STAMP_LENGTH || !isDigits(suffix, 0, 8) || suffix[8] != '-' || 
+    !isDigits(suffix, 9, STAMP_LENGTH))
+  {
+    return false;
+  }
+
+  segment.stamp = suffix.substr(0, STAMP_LENGTH);
+  segment.counter = 0;
+  if (end > STAMP_LENGTH)
+  {
+    if (suffix[STAMP_LENGTH] != '-' || 
+      !isDigits(suffix, STAMP_LENGTH + 1, end))
+    {
+      return false;
+    }
+    segment.counter = std::strtoul(
+      suffix.substr(STAMP_LENGTH + 1, end - STAMP_LENGTH - 1).c_str(), 
+      nullptr, 10);
+  }
+  return true;
+}
+
+/**
+ * Returns the names of the entries in a directory, which must end with a 
+ * separator.
+ */
+std::vector<std::string> listDirectory(const std::string& directory)
+{
+  std::vector<std::string> names;
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+  WIN32_FIND_DATAA entry;
+  HANDLE find = FindFirstFileA((directory + "*").c_str(), &entry);
+  if (find == INVALID_HANDLE_VALUE)
+  {
+    return names;
+  }
+  do
+  {
+    names.push_back(entry.cFileName);
+  } while (FindNextFileA(find, &entry));
+  FindClose(find);
+#else
+  DIR* dir = opendir(directory.c_str());
+  if (!dir)
+  {
+    return names;
+  }
+  while (dirent* entry = readdir(dir))
+  {
+    names.push_back(entry->d_name);
+  }
+  closedir(dir);
+#endif
+  return names;
+}
+
+}
+
+LogArchiver::LogArchiver(std::size_t maxFiles, bool compress, 
+  const std::string& filename)
+  : maxFiles(maxFiles),
+    compress(compress),
+    filename(filename),
+    pending(),
+    archived(),
+    mutex(),
+    condition(),
+    stopping(false),
+    worker()
+{
+  worker = std::thread(&LogArchiver::run, this);
+}
+
+LogArchiver::~LogArchiver()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    condition.notify_one();
+  }
+  worker.join();
+}
+
+void LogArchiver::add(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  assert(!stopping);
+  pending.push_back(path);
+  condition.notify_one();
+}
+
+bool LogArchiver::isCompressionAvailable()
+{
+#ifdef LU_LOG_USE_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool LogArchiver::compressFile(const std::string& source, 
+  const std::string& target)
+{
+#ifdef LU_LOG_USE_ZLIB
+  std::FILE* input = std::fopen(source.c_str(), "rb");
+  if (!input)
+  {
+    return false;
+  }
+
+  gzFile output = gzopen(target.c_str(), "wb");
+  if (!output)
+  {
+    std::fclose(input);
+    return false;
+  }
+
+  bool result = true;
+  char buffer[64 * 1024];
+  std::size_t count;
+  while ((count = std::fread(buffer, 1, sizeof(buffer), input)) > 0)
+  {
+    if (gzwrite(output, buffer, static_cast<unsigned>(count)) != 
+      static_cast<int>(count))
+    {
+      result = false;
+      break;
+    }
+  }
+
+  result = !std::ferror(input) && result;
+  result = gzclose(output) == Z_OK && result;
+  std::fclose(input);
+  if (!result)
+  {
+    std::remove(target.c_str());
+  }
+  return result;
+#else
+  LU_UNUSED(source);
+  LU_UNUSED(target);
+  return false;
+#endif
+}
+
+std::vector<std::string> LogArchiver::findSegments(
+  const std::string& filename)
+{
+  // the directory keeps its trailing separator, so that the paths found are 
+  // spelled the same way as the filename
+  std::size_t slash = filename.find_last_of("/\\");
+  std::string directory = slash != std::string::npos ? 
+    filename.substr(0, slash + 1) : std::string();
+  std::string prefix = filename.substr(directory.size()) + ".";
+
+  std::vector<Segment> segments;
+  for (const std::string& name : 
+    listDirectory(directory.empty() ? "./" : directory))
+  {
+    Segment segment;
+    if (name.size() > prefix.size() && 
+      name.compare(0, prefix.size(), prefix) == 0 && 
+      parseSegment(name.substr(prefix.size()), segment))
+    {
+      segment.path = directory + name;
+      segments.push_back(std::move(segment));
+    }
+  }
+  std::sort(segments.begin(), segments.end());
+
+  std::vector<std::string> paths;
+  for (Segment& segment : segments)
+  {
+    paths.push_back(std::move(segment.path));
+  }
+  return paths;
+}
+
+void LogArchiver::archive(std::string path)
+{
+  const std::string original = path;
+  if (compress && isCompressionAvailable())
+  {
+    std::string target = path + ".gz";
+    if (compressFile(path, target))
+    {
+      std::remove(path.c_str());
+      path = target;
+    }
+  }
+
+  // a segment may already have been found on disk before it was added
+  archived.erase(std::remove(archived.begin(), archived.end(), original), 
+    archived.end());
+  archived.push_back(path);
+  prune();
+}
+
+void LogArchiver::prune()
+{
+  while (maxFiles > 0 && archived.size() > maxFiles)
+  {
+    std::remove(archived.front().c_str());
+    archived.pop_front();
+  }
+}
+
+void LogArchiver::run()
+{
+  for (std::string& path : findSegments(filename))
+  {
+    archived.push_back(std::move(path));
+  }
+  prune();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    condition.wait(lock, [this] { return stopping || !pending.empty(); });
+    if (pending.empty())
+    {
+      break;
+    }
+
+    std::string path = std::move(pending.front());
+    pending.pop_front();
+
+    lock.unlock();
+    archive(std::move(path));
+    lock.lock();
+  }
+}
+
+}
@@ -0,0 +1,207 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "log/LogClock.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <ctime>
+
+namespace util
+{
+
+namespace
+{
+
+/** The time between calibrations. */
+const std::chrono::seconds CALIBRATION_INTERVAL(1);
+
+/** The shortest time the first rate of the cycle counter is measured over. */
+const std::chrono::milliseconds MIN_CALIBRATION_TIME(10);
+
+std::int64_t toNanoseconds(std::chrono::system_clock::time_point time)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    time.time_since_epoch()).count();
+}
+
+std::int64_t getMonotonicNanoseconds()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * The state of the calibration, and the thread that repeats it.
+ */
+struct Calibration
+{
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping;
+  std::thread worker;
+  // the first reading of the cycle counter, the rate is measured from it
+  bool hasAnchor;
+  std::uint64_t anchorCycles;
+  std::int64_t anchorTime;
+
+  Calibration()
+    : mutex(), 
+      condition(), 
+      stopping(false), 
+      worker(), 
+      hasAnchor(false), 
+      anchorCycles(0), 
+      anchorTime(0)
+  {
+  }
+
+  ~Calibration()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      condition.notify_one();
+    }
+    if (worker.joinable())
+    {
+      worker.join();
+    }
+  }
+
+  void start()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!worker.joinable())
+    {
+      worker = std::thread(&Calibration::run, this);
+    }
+  }
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!condition.wait_for(lock, CALIBRATION_INTERVAL, 
+      [this] { return stopping; }))
+    {
+      lock.unlock();
+      LogClock::calibrate();
+      lock.lock();
+    }
+  }
+};
+
+Calibration& getCalibration()
+{
+  static Calibration calibration;
+  return calibration;
+}
+
+}
+
+std::atomic<LogClockType> LogClock::type(LogClockType::System);
+std::atomic<std::int64_t> LogClock::monotonicOffset(0);
+std::atomic<std::uint64_t> LogClock::cycleSequence(0);
+std::atomic<std::uint64_t> LogClock::cycleBase(0);
+std::atomic<std::int64_t> LogClock::cycleBaseTime(0);
+std::atomic<double> LogClock::nanosecondsPerCycle(0.0);
+
+void LogClock::setType(LogClockType type)
+{
+  if (type == LogClockType::Monotonic || type == LogClockType::Cycle)
+  {
+    calibrate();
+    if (type == LogClockType::Cycle && 
+      nanosecondsPerCycle.load(std::memory_order_relaxed) == 0.0)
+    {
+      std::this_thread::sleep_for(MIN_CALIBRATION_TIME);
+      calibrate();
+    }
+    getCalibration().start();
+  }
+  LogClock::type.store(type, std::memory_order_relaxed);
+}
+
+LogClockType LogClock::getType()
+{
+  return type.load(std::memory_order_relaxed);
+}
+
+void LogClock::calibrate()
+{
+  auto& calibration = getCalibration();
+  std::lock_guard<std::mutex> lock(calibration.mutex);
+
+  // each counter is read on both sides of the real time clock, and the 
+  // midpoint taken as the time it was read at
+  auto monotonicBefore = getMonotonicNanoseconds();
+  auto cyclesBefore = readCycles();
+  auto time = toNanoseconds(std::chrono::system_clock::now());
+  auto cyclesAfter = readCycles();
+  auto monotonicAfter = getMonotonicNanoseconds();
+  auto monotonic = monotonicBefore + (monotonicAfter - monotonicBefore) / 2;
+  auto cycles = cyclesBefore + (cyclesAfter - cyclesBefore) / 2;
+
+  monotonicOffset.store(time - monotonic, std::memory_order_relaxed);
+
+  if (!calibration.hasAnchor)
+  {
+    calibration.hasAnchor = true;
+    calibration.anchorCycles = cycles;
+    calibration.anchorTime = time;
+    return;
+  }
+
+  auto elapsedTime = time - calibration.anchorTime;
+  auto elapsedCycles = cycles - calibration.anchorCycles;
+  if (elapsedTime < std::chrono::duration_cast<std::chrono::nanoseconds>(
+    MIN_CALIBRATION_TIME).count() || elapsedCycles == 0)
+  {
+    return;
+  }
+
+  // the rate is measured over the whole time since the anchor, which makes 
+  // it more accurate with every calibration
+  double rate = static_cast<double>(elapsedTime) / 
+    static_cast<double>(elapsedCycles);
+  auto sequence = cycleSequence.load(std::memory_order_relaxed);
+  cycleSequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  cycleBase.store(cycles, std::memory_order_relaxed);
+  cycleBaseTime.store(time, std::memory_order_relaxed);
+  nanosecondsPerCycle.store(rate, std::memory_order_relaxed);
+  cycleSequence.store(sequence + 2, std::memory_order_release);
+}
+
+LogClock::time_point LogClock::nowCoarse()
+{
+#if LU_PLATFORM == LU_PLATFORM_LINUX
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  return fromNanoseconds(static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + 
+    ts.tv_nsec);
+#else
+  return std::chrono::system_clock::now();
+#endif
+}
+
+}
@@ -0,0 +1,238 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/LogFormat.h"
+#include <deque>
+
+// Buffers that grow beyond this size are released when they are returned, 
+// so one huge message does not pin memory for the life of the thread.
+static const std::size_t MAX_RETAINED_BUFFER = 64 * 1024;
+
+namespace util
+{
+
+namespace
+{
+
+const char DIGIT_PAIRS[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+void appendUnsigned(std::string& out, unsigned long long value)
+{
+  // enough for 2^64 - 1
+  char digits[20];
+  char* pos = digits + sizeof(digits);
+
+  while (value >= 100)
+  {
+    auto pair = static_cast<std::size_t>(value % 100) * 2;
+    value /= 100;
+    *--pos = DIGIT_PAIRS[pair + 1];
+    *--pos = DIGIT_PAIRS[pair];
+  }
+  if (value >= 10)
+  {
+    auto pair = static_cast<std::size_t>(value) * 2;
+    *--pos = DIGIT_PAIRS[pair + 1];
+    *--pos = DIGIT_PAIRS[pair];
+  }
+  else
+  {
+    *--pos = static_cast<char>('0' + value);
+  }
+
+  out.append(pos, digits + sizeof(digits));
+}
+
+void appendSigned(std::string& out, long long value)
+{
+  if (value < 0)
+  {
+    out.push_back('-');
+    // negate as unsigned so the minimum value does not overflow
+    appendUnsigned(out, 0ull - static_cast<unsigned long long>(value));
+  }
+  else
+  {
+    appendUnsigned(out, static_cast<unsigned long long>(value));
+  }
+}
+
+/**
+ * The buffers owned by a thread.  A deque keeps references stable while 
+ * nested scopes add buffers.
+ */
+struct ThreadBuffers
+{
+  std::deque<std::string> buffers;
+  std::size_t depth = 0;
+};
+
+ThreadBuffers& getThreadBuffers()
+{
+  static thread_local ThreadBuffers threadBuffers;
+  return threadBuffers;
+}
+
+std::string& acquireBuffer()
+{
+  auto& tb = getThreadBuffers();
+  if (tb.depth == tb.buffers.size())
+  {
+    tb.buffers.emplace_back();
+  }
+  auto& buffer = tb.buffers[tb.depth++];
+  buffer.clear();
+  return buffer;
+}
+
+}
+
+void formatValue(std::string& out, bool value)
+{
+  if (value)
+  {
+    out.append("true", 4);
+  }
+  else
+  {
+    out.append("false", 5);
+  }
+}
+
+void formatValue(std::string& out, char value)
+{
+  out.push_back(value);
+}
+
+void formatValue(std::string& out, int value)
+{
+  appendSigned(out, value);
+}
+
+void formatValue(std::string& out, unsigned int value)
+{
+  appendUnsigned(out, value);
+}
+
+void formatValue(std::string& out, long value)
+{
+  appendSigned(out, value);
+}
+
+void formatValue(std::string& out, unsigned long value)
+{
+  appendUnsigned(out, value);
+}
+
+void formatValue(std::string& out, long long value)
+{
+  appendSigned(out, value);
+}
+
+void formatValue(std::string& out, unsigned long long value)
+{
+  appendUnsigned(out, value);
+}
+
+void formatValue(std::string& out, double value)
+{
+  // matches the default output of std::ostream
+  char buffer[32];
+  int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+  assert(length > 0 && length < static_cast<int>(sizeof(buffer)));
+  out.append(buffer, static_cast<std::size_t>(length));
+}
+
+void formatValue(std::string& out, long double value)
+{
+  char buffer[64];
+  int length = std::snprintf(buffer, sizeof(buffer), "%Lg", value);
+  assert(length > 0 && length < static_cast<int>(sizeof(buffer)));
+  out.append(buffer, static_cast<std::size_t>(length));
+}
+
+void formatValue(std::string& out, const char* value)
+{
+  if (value)
+  {
+    out.append(value);
+  }
+  else
+  {
+    out.append("(null)", 6);
+  }
+}
+
+void formatValue(std::string& out, const std::string& value)
+{
+  out.append(value);
+}
+
+void formatValue(std::string& out, StringRef value)
+{
+  out.append(value.data(), value.size());
+}
+
+void formatValue(std::string& out, const void* value)
+{
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  char digits[2 * sizeof(std::uintptr_t)];
+  char* pos = digits + sizeof(digits);
+  auto bits = reinterpret_cast<std::uintptr_t>(value);
+  do
+  {
+    *--pos = HEX_DIGITS[bits & 0xf];
+    bits >>= 4;
+  } while (bits != 0);
+
+  out.append("0x", 2);
+  out.append(pos, digits + sizeof(digits));
+}
+
+ScopedLogBuffer::ScopedLogBuffer()
+  : buffer(acquireBuffer())
+{
+}
+
+ScopedLogBuffer::~ScopedLogBuffer()
+{
+  auto& tb = getThreadBuffers();
+  assert(tb.depth > 0 && &tb.buffers[tb.depth - 1] == &buffer);
+  if (buffer.capacity() > MAX_RETAINED_BUFFER)
+  {
+    std::string().swap(buffer);
+  }
+  tb.depth--;
+}
+
+}
@@ -0,0 +1,168 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/LogFormatCache.h"
+#include <deque>
+
+// Buffers that grow beyond this size are released when they are returned, 
+// so one huge batch does not pin memory for the life of the thread.
+static const std::size_t MAX_RETAINED_BUFFER = 64 * 1024;
+
+namespace util
+{
+
+namespace
+{
+
+struct ThreadLines
+{
+  std::deque<FormattedLines> lines;
+  std::size_t depth = 0;
+};
+
+ThreadLines& getThreadLines()
+{
+  static thread_local ThreadLines threadLines;
+  return threadLines;
+}
+
+}
+
+StringRef FormattedLines::getAll() const
+{
+  return text;
+}
+
+StringRef FormattedLines::getLine(std::size_t index) const
+{
+  assert(index < ends.size());
+  std::size_t begin = index > 0 ? ends[index - 1] : 0;
+  return StringRef(text.data() + begin, ends[index] - begin);
+}
+
+LogFormatCache::LogFormatCache(const LogMessage* const* msgs, 
+  std::size_t count)
+  : msgs(msgs),
+    count(count),
+    entries(),
+    entryCount(0),
+    borrowed(0)
+{
+}
+
+LogFormatCache::~LogFormatCache()
+{
+  // buffers are borrowed from the top of the thread's stack, and caches 
+  // made while this one is alive have returned theirs already
+  auto& tl = getThreadLines();
+  assert(tl.depth >= borrowed);
+  for (; borrowed > 0; borrowed--)
+  {
+    FormattedLines& lines = tl.lines[--tl.depth];
+    if (lines.text.capacity() > MAX_RETAINED_BUFFER)
+    {
+      std::string().swap(lines.text);
+    }
+  }
+}
+
+std::size_t LogFormatCache::getCount() const
+{
+  return count;
+}
+
+const LogMessage& LogFormatCache::getMessage(std::size_t index) const
+{
+  assert(index < count);
+  return *msgs[index];
+}
+
+void LogFormatCache::require(const ILogFormatter& formatter, 
+  LogLevelMask levels)
+{
+  Entry* entry = findEntry(formatter);
+  if (entry && !entry->lines)
+  {
+    entry->levels |= levels;
+  }
+}
+
+const FormattedLines* LogFormatCache::format(ILogFormatter& formatter, 
+  LogLevelMask levels)
+{
+  Entry* entry = findEntry(formatter);
+  if (!entry)
+  {
+    return nullptr;
+  }
+  if (entry->lines)
+  {
+    // a writer added after the levels were required may need more
+    return (entry->levels & levels) == levels ? entry->lines : nullptr;
+  }
+
+  auto& tl = getThreadLines();
+  if (tl.depth == tl.lines.size())
+  {
+    tl.lines.emplace_back();
+  }
+  FormattedLines* lines = &tl.lines[tl.depth++];
+  borrowed++;
+  entry->levels |= levels;
+  entry->lines = lines;
+
+  StringRef terminator = formatter.getTerminator();
+  lines->text.clear();
+  lines->ends.clear();
+  for (std::size_t i = 0; i < count; i++)
+  {
+    if (entry->levels & getLevelMask(msgs[i]->level))
+    {
+      formatter.append(*msgs[i], lines->text);
+      lines->text.append(terminator.data(), terminator.size());
+    }
+    lines->ends.push_back(lines->text.size());
+  }
+  return lines;
+}
+
+LogFormatCache::Entry* LogFormatCache::findEntry(
+  const ILogFormatter& formatter)
+{
+  for (std::size_t i = 0; i < entryCount; i++)
+  {
+    if (entries[i].formatter == &formatter)
+    {
+      return &entries[i];
+    }
+  }
+
+  if (entryCount == MAX_FORMATTERS)
+  {
+    return nullptr;
+  }
+  entries[entryCount] = Entry{&formatter, 0, nullptr};
+  return &entries[entryCount++];
+}
+
+}
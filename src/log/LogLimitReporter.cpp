@@ -0,0 +1,64 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "log/LogLimitReporter.h"
+#include "log/Log.h"
+
+namespace util
+{
+
+LogLimitReporter::LogLimitReporter(Log& log, 
+  std::chrono::milliseconds interval)
+  : log(log),
+    interval(interval),
+    mutex(),
+    condition(),
+    stopping(false),
+    worker()
+{
+  assert(log.isAsync());
+  worker = std::thread(&LogLimitReporter::run, this);
+}
+
+LogLimitReporter::~LogLimitReporter()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    condition.notify_one();
+  }
+  worker.join();
+  LogLimitSite::reportSuppressed(log);
+}
+
+void LogLimitReporter::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!condition.wait_for(lock, interval, [this] { return stopping; }))
+  {
+    lock.unlock();
+    LogLimitSite::reportSuppressed(log);
+    lock.lock();
+  }
+}
+
+}
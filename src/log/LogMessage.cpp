@@ -27,6 +27,11 @@ namespace util
 {
 
 std::string toString(const LogLevel level)
+{
+  return getLevelName(level).str();
+}
+
+StringRef getLevelName(LogLevel level)
 {
   switch (level)
   {
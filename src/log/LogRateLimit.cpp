@@ -0,0 +1,209 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "log/LogRateLimit.h"
+#include "log/Log.h"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace util
+{
+
+namespace
+{
+
+/**
+ * Every live call site.
+ */
+struct SiteRegistry
+{
+  std::mutex mutex;
+  std::vector<LogLimitSite*> sites;
+};
+
+SiteRegistry& getSiteRegistry()
+{
+  static SiteRegistry registry;
+  return registry;
+}
+
+std::int64_t getTokenInterval(const LogRateLimit& limit)
+{
+  if (limit.type != LogRateLimitType::TokenBucket)
+  {
+    return 0;
+  }
+  return 1000000000 / static_cast<std::int64_t>(limit.count);
+}
+
+std::int64_t getTokenTolerance(const LogRateLimit& limit)
+{
+  if (limit.type != LogRateLimitType::TokenBucket)
+  {
+    return 0;
+  }
+  auto burst = static_cast<std::int64_t>(limit.period);
+  return getTokenInterval(limit) * (burst - 1);
+}
+
+/**
+ * A report collected from a site while the registry is locked.
+ */
+struct SiteReport
+{
+  LogLevel level;
+  std::string tag;
+  LogSource source;
+  std::uint64_t count;
+};
+
+}
+
+LogRateLimit LogRateLimit::perSecond(std::uint32_t rate, std::uint32_t burst)
+{
+  assert(rate > 0 && rate <= 1000000000);
+  assert(burst > 0);
+  return LogRateLimit{LogRateLimitType::TokenBucket, rate, burst};
+}
+
+LogRateLimit LogRateLimit::sample(std::uint32_t n)
+{
+  assert(n > 0);
+  return LogRateLimit{LogRateLimitType::Sample, n, 0};
+}
+
+LogRateLimit LogRateLimit::firstThenEvery(std::uint32_t first, 
+  std::uint32_t every)
+{
+  assert(every > 0);
+  return LogRateLimit{LogRateLimitType::FirstThenEvery, first, every};
+}
+
+LogLimitSite::LogLimitSite(const LogRateLimit& limit, LogLevel level, 
+  StringRef tag, const LogSource& source)
+  : limit(limit),
+    source(source),
+    level(level),
+    tag(tag.str()),
+    interval(getTokenInterval(limit)),
+    tolerance(getTokenTolerance(limit)),
+    calls(0),
+    dueTime(0),
+    suppressed(0),
+    reported(0)
+{
+  registerSite();
+}
+
+LogLimitSite::LogLimitSite(const LogRateLimit& limit, LogLevel level, 
+  const LogTag& tag, const LogSource& source)
+  : LogLimitSite(limit, level, tag.getName(), source)
+{
+}
+
+LogLimitSite::~LogLimitSite()
+{
+  auto& registry = getSiteRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto itr = std::find(registry.sites.begin(), registry.sites.end(), this);
+  assert(itr != registry.sites.end());
+  registry.sites.erase(itr);
+}
+
+std::uint64_t LogLimitSite::getSuppressed() const
+{
+  std::uint64_t count = calls.load(std::memory_order_relaxed);
+  switch (limit.type)
+  {
+  case LogRateLimitType::TokenBucket:
+    return suppressed.load(std::memory_order_relaxed);
+
+  case LogRateLimitType::Sample:
+    return count - (count + limit.count - 1) / limit.count;
+
+  case LogRateLimitType::FirstThenEvery:
+    if (count <= limit.count)
+    {
+      return 0;
+    }
+    return count - limit.count - (count - limit.count) / limit.period;
+  }
+
+  // suppress warnings
+  return 0;
+}
+
+std::size_t LogLimitSite::reportSuppressed(Log& log)
+{
+  // the reports are logged after the registry is unlocked, so that a writer 
+  // may create sites of its own
+  std::vector<SiteReport> reports;
+  {
+    auto& registry = getSiteRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (LogLimitSite* site : registry.sites)
+    {
+      std::uint64_t total = site->getSuppressed();
+      if (total == site->reported)
+      {
+        continue;
+      }
+      reports.push_back(SiteReport{site->level, site->tag, site->source, 
+        total - site->reported});
+      site->reported = total;
+    }
+  }
+
+  for (const SiteReport& report : reports)
+  {
+    log.stream(report.level, report.tag, report.source) << "Suppressed " << 
+      report.count << " messages since the last report";
+  }
+  return reports.size();
+}
+
+bool LogLimitSite::tryTakeToken(std::int64_t now, std::int64_t due)
+{
+  for (;;)
+  {
+    auto next = std::max(due, now) + interval;
+    if (dueTime.compare_exchange_weak(due, next, std::memory_order_relaxed))
+    {
+      return true;
+    }
+    if (due - now > tolerance)
+    {
+      suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+}
+
+void LogLimitSite::registerSite()
+{
+  auto& registry = getSiteRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.sites.push_back(this);
+}
+
+}
@@ -0,0 +1,168 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "log/LogRegistry.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace util
+{
+
+namespace
+{
+
+/**
+ * A log in the registry and its place in the tree.
+ */
+struct Node
+{
+  std::unique_ptr<Log> log;
+  Node* parent;
+  std::vector<Node*> children;
+  bool hasLevel;
+  LogLevel level;
+};
+
+struct Registry
+{
+  std::mutex mutex;
+  StrongPtr<LogWriterSet> writers;
+  std::unordered_map<std::string, std::unique_ptr<Node>> nodes;
+  Node* root;
+
+  Registry()
+    : mutex(), 
+      writers(std::make_shared<LogWriterSet>()), 
+      nodes(), 
+      root(nullptr)
+  {
+    std::unique_ptr<Node> node(new Node{
+      std::unique_ptr<Log>(new Log("", writers, LogLevel::All)),
+      nullptr,
+      std::vector<Node*>(),
+      true,
+      LogLevel::All
+    });
+    root = node.get();
+    nodes[""] = std::move(node);
+  }
+
+  /**
+   * Finds or creates a node and its missing parents.  The mutex must be 
+   * held.
+   */
+  Node* find(const std::string& name)
+  {
+    auto itr = nodes.find(name);
+    if (itr != nodes.end())
+    {
+      return itr->second.get();
+    }
+
+    auto dot = name.rfind('.');
+    Node* parent = find(dot == std::string::npos ? 
+      std::string() : name.substr(0, dot));
+
+    std::unique_ptr<Node> node(new Node{
+      std::unique_ptr<Log>(new Log(name, writers, parent->log->getLevel())),
+      parent,
+      std::vector<Node*>(),
+      false,
+      LogLevel::All
+    });
+    Node* result = node.get();
+    parent->children.push_back(result);
+    nodes[name] = std::move(node);
+    return result;
+  }
+
+  /**
+   * Stores the effective level of a node and its descendants.  The mutex 
+   * must be held.
+   */
+  static void propagate(Node* node, LogLevel inherited)
+  {
+    LogLevel effective = node->hasLevel ? node->level : inherited;
+    node->log->setLevel(effective);
+    for (Node* child : node->children)
+    {
+      propagate(child, effective);
+    }
+  }
+};
+
+Registry& getRegistry()
+{
+  static Registry registry;
+  return registry;
+}
+
+}
+
+Log& LogRegistry::get(const std::string& name)
+{
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return *registry.find(name)->log;
+}
+
+Log& LogRegistry::getRoot()
+{
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return *registry.root->log;
+}
+
+void LogRegistry::setLevel(const std::string& name, LogLevel level)
+{
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  Node* node = registry.find(name);
+  node->hasLevel = true;
+  node->level = level;
+  Registry::propagate(node, level);
+}
+
+void LogRegistry::clearLevel(const std::string& name)
+{
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  Node* node = registry.find(name);
+  if (node == registry.root)
+  {
+    return;
+  }
+  node->hasLevel = false;
+  Registry::propagate(node, node->parent->log->getLevel());
+}
+
+bool LogRegistry::hasLevel(const std::string& name)
+{
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto itr = registry.nodes.find(name);
+  return itr != registry.nodes.end() && itr->second->hasLevel;
+}
+
+}
@@ -0,0 +1,124 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/LogStream.h"
+#include <deque>
+
+// Buffers that grow beyond this size are released when they are returned, 
+// so one huge message does not pin memory for the life of the thread.
+static const std::size_t MAX_RETAINED_BUFFER = 64 * 1024;
+
+namespace util
+{
+
+namespace
+{
+
+struct ThreadStreams
+{
+  std::deque<LogStreamBuffer> streams;
+  std::size_t depth = 0;
+};
+
+ThreadStreams& getThreadStreams()
+{
+  static thread_local ThreadStreams threadStreams;
+  return threadStreams;
+}
+
+}
+
+LogStreamBuffer::LogStreamBuffer()
+  : buffer(),
+    chunk(),
+    stream(this)
+{
+  setp(chunk, chunk + sizeof(chunk));
+}
+
+void LogStreamBuffer::reset()
+{
+  buffer.clear();
+  setp(chunk, chunk + sizeof(chunk));
+
+  // undo any manipulators left over from the previous message
+  stream.clear();
+  stream.flags(std::ios::dec | std::ios::skipws);
+  stream.width(0);
+  stream.precision(6);
+  stream.fill(' ');
+}
+
+StringRef LogStreamBuffer::str()
+{
+  flushChunk();
+  return buffer;
+}
+
+LogStreamBuffer& LogStreamBuffer::acquire()
+{
+  auto& ts = getThreadStreams();
+  if (ts.depth == ts.streams.size())
+  {
+    ts.streams.emplace_back();
+  }
+  auto& result = ts.streams[ts.depth++];
+  result.reset();
+  return result;
+}
+
+void LogStreamBuffer::release(LogStreamBuffer& buffer)
+{
+  auto& ts = getThreadStreams();
+  assert(ts.depth > 0 && &ts.streams[ts.depth - 1] == &buffer);
+  if (buffer.buffer.capacity() > MAX_RETAINED_BUFFER)
+  {
+    std::string().swap(buffer.buffer);
+  }
+  ts.depth--;
+}
+
+LogStreamBuffer::int_type LogStreamBuffer::overflow(int_type ch)
+{
+  flushChunk();
+  if (!traits_type::eq_int_type(ch, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int LogStreamBuffer::sync()
+{
+  flushChunk();
+  return 0;
+}
+
+void LogStreamBuffer::flushChunk()
+{
+  buffer.append(pbase(), pptr());
+  setp(chunk, chunk + sizeof(chunk));
+}
+
+}
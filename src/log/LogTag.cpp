@@ -0,0 +1,99 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/LogTag.h"
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace util
+{
+
+namespace
+{
+
+/**
+ * The interned names, indexed by id.  A deque is used so that names never 
+ * move once stored.  Id zero is the overflow id, so the first name gets id 
+ * one.
+ */
+struct TagRegistry
+{
+  std::mutex mutex;
+  std::deque<std::string> names;
+  std::unordered_map<std::string, LogTagId> index;
+};
+
+TagRegistry& getTagRegistry()
+{
+  static TagRegistry registry;
+  return registry;
+}
+
+}
+
+std::atomic<std::uint8_t> LogTag::levels[LogTag::MAX_TAGS];
+
+LogTag::LogTag(StringRef name)
+  : id(0),
+    name()
+{
+  auto& registry = getTagRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  LogTagId index;
+  std::string key = name.str();
+  auto itr = registry.index.find(key);
+  if (itr != registry.index.end())
+  {
+    index = itr->second;
+  }
+  else
+  {
+    if (registry.names.empty())
+    {
+      registry.names.emplace_back();
+    }
+    index = static_cast<LogTagId>(registry.names.size());
+    registry.names.push_back(key);
+    registry.index.emplace(std::move(key), index);
+  }
+
+  // names beyond the table keep their own entry, but share the overflow id
+  id = index < MAX_TAGS ? index : 0;
+  this->name = registry.names[index];
+}
+
+void LogTag::setLevel(LogLevel level) const
+{
+  levels[id].store(static_cast<std::uint8_t>(static_cast<int>(level) + 1), 
+    std::memory_order_relaxed);
+}
+
+void LogTag::clearLevel() const
+{
+  levels[id].store(0, std::memory_order_relaxed);
+}
+
+}
@@ -22,20 +22,127 @@
 */
 
 #include "log/LogWriter.h"
+#include "log/LogClock.h"
+#include "log/LogFormat.h"
+#include <mutex>
 
 namespace util
 {
 
+namespace
+{
+
+/**
+ * FNV-1a hash of the parts of a message compared for repeats.
+ */
+std::size_t hashMessage(const LogMessage& msg)
+{
+  std::uint64_t hash = 14695981039346656037ull;
+  auto mix = [&hash](StringRef text)
+  {
+    for (char c : text)
+    {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ull;
+    }
+    // separates the tag from the message
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+  };
+  hash ^= static_cast<std::uint64_t>(msg.level);
+  hash *= 1099511628211ull;
+  mix(msg.tag);
+  mix(msg.message);
+  return static_cast<std::size_t>(hash);
+}
+
+std::int64_t toNanoseconds(std::chrono::system_clock::time_point time)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    time.time_since_epoch()).count();
+}
+
+}
+
+/**
+ * The last message written by a coalescing writer, and how many times it 
+ * has been repeated since.
+ */
+struct LogWriter::RepeatState
+{
+  std::mutex mutex;
+  const std::chrono::milliseconds window;
+  bool hasLast;
+  std::size_t hash;
+  LogLevel level;
+  std::string logName;
+  std::string tag;
+  std::string message;
+  LogSource source;
+  std::uint64_t count;
+  std::chrono::system_clock::time_point first;
+  std::chrono::system_clock::time_point last;
+
+  explicit RepeatState(std::chrono::milliseconds window)
+    : mutex(),
+      window(window),
+      hasLast(false),
+      hash(0),
+      level(LogLevel::All),
+      logName(),
+      tag(),
+      message(),
+      source(),
+      count(0),
+      first(),
+      last()
+  {
+  }
+
+  bool isRepeat(const LogMessage& msg, std::size_t msgHash) const
+  {
+    return hasLast && hash == msgHash && level == msg.level && 
+      tag == msg.tag && message == msg.message;
+  }
+
+  bool hasExpired(std::chrono::system_clock::time_point now) const
+  {
+    return count > 0 && now - first >= window;
+  }
+};
+
 LogWriter::LogWriter()
-  : formatter(nullptr), outputLevel(LogLevel::All)
+  : formatter(nullptr), outputLevel(LogLevel::All), repeats()
 {}
 
+LogWriter::LogWriter(const LogWriter& other)
+  : formatter(other.formatter), outputLevel(other.outputLevel), repeats()
+{
+  if (other.repeats)
+  {
+    repeats.reset(new RepeatState(other.repeats->window));
+  }
+}
+
+LogWriter::~LogWriter()
+{
+}
+
+LogWriter& LogWriter::operator=(const LogWriter& other)
+{
+  formatter = other.formatter;
+  outputLevel = other.outputLevel;
+  repeats.reset(other.repeats ? 
+    new RepeatState(other.repeats->window) : nullptr);
+  return *this;
+}
+
 void LogWriter::setFormatter(StrongLogFormatterPtr formatter)
 {
   this->formatter = formatter;
 }
 
-StrongLogFormatterPtr LogWriter::getFormatter() const
+const StrongLogFormatterPtr& LogWriter::getFormatter() const
 {
   return formatter;
 }
@@ -55,14 +162,235 @@ bool LogWriter::isActive(LogLevel level) const
   return outputLevel <= level;
 }
 
-void LogWriter::write(StrongLogMessagePtr msg)
+LogLevelMask LogWriter::getLevelMask() const
+{
+  return getLevelsFrom(outputLevel);
+}
+
+void LogWriter::setCoalescing(bool enabled, 
+  std::chrono::milliseconds window)
+{
+  repeats.reset(enabled ? new RepeatState(window) : nullptr);
+}
+
+bool LogWriter::isCoalescing() const
+{
+  return repeats != nullptr;
+}
+
+void LogWriter::flushRepeats()
+{
+  if (!repeats)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(repeats->mutex);
+  if (repeats->count == 0)
+  {
+    return;
+  }
+
+  ScopedLogBuffer buffer;
+  appendRepeats(buffer.get());
+  output(buffer.get());
+}
+
+void LogWriter::flushExpiredRepeats()
+{
+  if (!repeats)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(repeats->mutex);
+  if (!repeats->hasExpired(LogClock::now()))
+  {
+    return;
+  }
+
+  ScopedLogBuffer buffer;
+  appendRepeats(buffer.get());
+  output(buffer.get());
+}
+
+void LogWriter::write(const LogMessage& msg)
 {
-  assert(msg != nullptr);
-  if (isActive(msg->level))
+  const LogMessage* msgs[] = { &msg };
+  write(msgs, 1);
+}
+
+void LogWriter::write(const LogMessage* const* msgs, std::size_t count)
+{
+  LogFormatCache cache(msgs, count);
+  write(cache);
+}
+
+void LogWriter::prepare(LogFormatCache& cache)
+{
+  if (formatter)
+  {
+    cache.require(*formatter, getLevelMask());
+  }
+}
+
+void LogWriter::write(LogFormatCache& cache)
+{
+  if (repeats)
+  {
+    writeCoalesced(cache);
+    return;
+  }
+
+  std::size_t count = cache.getCount();
+  std::size_t active = 0;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    if (isActive(cache.getMessage(i).level))
+    {
+      active++;
+    }
+  }
+
+  if (active == 0)
+  {
+    return;
+  }
+
+  assert(formatter != nullptr);
+  const FormattedLines* formatted = cache.format(*formatter, getLevelMask());
+  if (formatted && active == count)
   {
-    assert(formatter != nullptr);
-    output(formatter->format(*msg));
+    output(formatted->getAll());
+    return;
   }
+
+  StringRef terminator = formatter->getTerminator();
+  ScopedLogBuffer buffer;
+  std::string& lines = buffer.get();
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const LogMessage& msg = cache.getMessage(i);
+    if (!isActive(msg.level))
+    {
+      continue;
+    }
+
+    if (formatted)
+    {
+      lines += formatted->getLine(i);
+    }
+    else
+    {
+      formatter->append(msg, lines);
+      lines.append(terminator.data(), terminator.size());
+    }
+  }
+  output(lines);
+}
+
+void LogWriter::writeCoalesced(LogFormatCache& cache)
+{
+  assert(formatter != nullptr);
+  StringRef terminator = formatter->getTerminator();
+  const FormattedLines* formatted = nullptr;
+
+  // the lock is held while the records are output, so that the summary of a 
+  // run is always written before the message that ended it
+  std::lock_guard<std::mutex> lock(repeats->mutex);
+  ScopedLogBuffer buffer;
+  std::string& lines = buffer.get();
+  if (repeats->hasExpired(LogClock::now()))
+  {
+    appendRepeats(lines);
+  }
+
+  for (std::size_t i = 0; i < cache.getCount(); i++)
+  {
+    const LogMessage& msg = cache.getMessage(i);
+    if (!isActive(msg.level))
+    {
+      continue;
+    }
+
+    std::size_t hash = hashMessage(msg);
+    if (repeats->isRepeat(msg, hash))
+    {
+      if (repeats->hasExpired(msg.timeStamp))
+      {
+        appendRepeats(lines);
+      }
+      if (repeats->count == 0)
+      {
+        repeats->first = msg.timeStamp;
+      }
+      repeats->count++;
+      repeats->last = msg.timeStamp;
+      continue;
+    }
+
+    appendRepeats(lines);
+    if (!formatted)
+    {
+      formatted = cache.format(*formatter, getLevelMask());
+    }
+    if (formatted)
+    {
+      lines += formatted->getLine(i);
+    }
+    else
+    {
+      formatter->append(msg, lines);
+      lines.append(terminator.data(), terminator.size());
+    }
+
+    // the strings keep their capacity, so this does not allocate once warm
+    repeats->hasLast = true;
+    repeats->hash = hash;
+    repeats->level = msg.level;
+    repeats->logName.assign(msg.logName.data(), msg.logName.size());
+    repeats->tag.assign(msg.tag.data(), msg.tag.size());
+    repeats->message.assign(msg.message.data(), msg.message.size());
+    repeats->source = msg.source;
+  }
+
+  if (!lines.empty())
+  {
+    output(lines);
+  }
+}
+
+void LogWriter::appendRepeats(std::string& lines)
+{
+  if (repeats->count == 0)
+  {
+    return;
+  }
+
+  ScopedLogBuffer buffer;
+  std::string& text = buffer.get();
+  text += "Last message repeated ";
+  formatValue(text, static_cast<unsigned long long>(repeats->count));
+  text += repeats->count == 1 ? " time" : " times";
+
+  const LogField fields[] = {
+    LogField("repeated", static_cast<unsigned long long>(repeats->count)),
+    LogField("first", static_cast<long long>(toNanoseconds(repeats->first))),
+    LogField("last", static_cast<long long>(toNanoseconds(repeats->last)))
+  };
+  LogMessage summary{
+    repeats->level,
+    repeats->last,
+    repeats->logName,
+    repeats->tag,
+    text,
+    repeats->source,
+    LogFields(fields, 3)
+  };
+  formatter->append(summary, lines);
+  StringRef terminator = formatter->getTerminator();
+  lines.append(terminator.data(), terminator.size());
+  repeats->count = 0;
 }
 
 }
@@ -0,0 +1,136 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/LogWriterSet.h"
+#include <algorithm>
+
+namespace util
+{
+
+namespace
+{
+
+LogWriterSet::Snapshot::const_iterator find(
+  const LogWriterSet::Snapshot& snapshot, const std::string& name)
+{
+  return std::find_if(snapshot.begin(), snapshot.end(),
+    [&](const LogWriterSet::Entry& entry) { return entry.first == name; });
+}
+
+}
+
+LogWriterSet::LogWriterSet()
+  : current(new Snapshot()),
+    updateMutex()
+{
+}
+
+LogWriterSet::LogWriterSet(const LogWriterSet& other)
+  : current(nullptr),
+    updateMutex()
+{
+  Rcu::ReadLock lock;
+  current.store(new Snapshot(*Rcu::dereference(other.current)));
+}
+
+LogWriterSet::~LogWriterSet()
+{
+  delete current.load();
+}
+
+LogWriterSet& LogWriterSet::operator=(const LogWriterSet& other)
+{
+  if (this != &other)
+  {
+    const Snapshot* copy;
+    {
+      Rcu::ReadLock lock;
+      copy = new Snapshot(*Rcu::dereference(other.current));
+    }
+    std::lock_guard<std::mutex> guard(updateMutex);
+    publish(copy);
+  }
+  return *this;
+}
+
+bool LogWriterSet::has(const std::string& name) const
+{
+  Rcu::ReadLock lock;
+  const Snapshot& snapshot = *Rcu::dereference(current);
+  return find(snapshot, name) != snapshot.end();
+}
+
+bool LogWriterSet::add(const std::string& name, StrongLogWriterPtr writer)
+{
+  assert(writer != nullptr);
+  std::lock_guard<std::mutex> guard(updateMutex);
+  const Snapshot& snapshot = *current.load();
+  if (find(snapshot, name) != snapshot.end())
+  {
+    return false;
+  }
+
+  auto next = new Snapshot();
+  next->reserve(snapshot.size() + 1);
+  *next = snapshot;
+  next->emplace_back(name, std::move(writer));
+  publish(next);
+  return true;
+}
+
+bool LogWriterSet::remove(const std::string& name)
+{
+  std::lock_guard<std::mutex> guard(updateMutex);
+  const Snapshot& snapshot = *current.load();
+  auto itr = find(snapshot, name);
+  if (itr == snapshot.end())
+  {
+    return false;
+  }
+
+  auto next = new Snapshot(snapshot.begin(), itr);
+  next->insert(next->end(), itr + 1, snapshot.end());
+  publish(next);
+  return true;
+}
+
+void LogWriterSet::clear()
+{
+  std::lock_guard<std::mutex> guard(updateMutex);
+  publish(new Snapshot());
+}
+
+std::size_t LogWriterSet::size() const
+{
+  Rcu::ReadLock lock;
+  return Rcu::dereference(current)->size();
+}
+
+void LogWriterSet::publish(const Snapshot* snapshot)
+{
+  auto old = Rcu::assign(current, snapshot);
+  Rcu::synchronize();
+  delete old;
+}
+
+}
@@ -0,0 +1,291 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/MappedLogFile.h"
+#include "utility/Rcu.h"
+#include <algorithm>
+
+#if LU_PLATFORM == LU_PLATFORM_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util
+{
+
+static std::uint64_t roundUp(std::uint64_t value, std::uint64_t multiple)
+{
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+MappedLogFile::MappedLogFile(std::size_t extentSize)
+  : extentSize(extentSize),
+    handle(-1),
+    tail(0),
+    window(nullptr),
+    allocated(0),
+    retired(),
+    mutex()
+{
+  assert(extentSize > 0);
+}
+
+MappedLogFile::~MappedLogFile()
+{
+  close();
+}
+
+bool MappedLogFile::isOpen() const
+{
+  return handle >= 0;
+}
+
+std::uint64_t MappedLogFile::getSize() const
+{
+  return tail.load(std::memory_order_relaxed);
+}
+
+#if LU_PLATFORM == LU_PLATFORM_LINUX
+
+bool MappedLogFile::open(const std::string& filename, bool append)
+{
+  close();
+
+  assert(!filename.empty());
+  int flags = O_RDWR | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC);
+  int fd = ::open(filename.c_str(), flags, 0644);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  handle = fd;
+  allocated = static_cast<std::uint64_t>(info.st_size);
+  tail.store(allocated, std::memory_order_relaxed);
+  return true;
+}
+
+void MappedLogFile::close()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (handle < 0)
+  {
+    return;
+  }
+
+  // no appends are in progress, so every window can be unmapped now
+  Window* current = Rcu::assign(window, static_cast<Window*>(nullptr));
+  if (current)
+  {
+    retired.push_back(RetiredWindow{current, 0});
+  }
+  reclaim(true);
+
+  // drop the preallocated space that was never written
+  auto size = tail.load(std::memory_order_relaxed);
+  int result = ftruncate(handle, static_cast<off_t>(size));
+  LU_UNUSED(result);
+  ::close(handle);
+  handle = -1;
+  allocated = 0;
+  tail.store(0, std::memory_order_relaxed);
+}
+
+void MappedLogFile::append(StringRef data)
+{
+  assert(isOpen());
+  if (data.empty())
+  {
+    return;
+  }
+
+  auto pos = tail.fetch_add(data.size(), std::memory_order_relaxed);
+  {
+    Rcu::ReadLock lock;
+    const Window* current = Rcu::dereference(window);
+    if (current && pos >= current->offset && 
+      pos + data.size() <= current->offset + current->size)
+    {
+      std::memcpy(current->data + (pos - current->offset), data.data(), 
+        data.size());
+      return;
+    }
+  }
+  appendSlow(pos, data);
+}
+
+void MappedLogFile::appendSlow(std::uint64_t pos, StringRef data)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (handle < 0)
+  {
+    return;
+  }
+
+  // the window only changes under the mutex, so it is safe to use here 
+  // without a read lock
+  Window* current = window.load(std::memory_order_relaxed);
+  auto end = pos + data.size();
+  if (current && pos >= current->offset && 
+    end <= current->offset + current->size)
+  {
+    std::memcpy(current->data + (pos - current->offset), data.data(), 
+      data.size());
+    return;
+  }
+
+  // slide the window forward to start at the page holding the data, unless 
+  // another thread has already moved it past this position
+  if (!current || pos >= current->offset)
+  {
+    auto pageSize = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    auto offset = pos - pos % pageSize;
+    auto size = static_cast<std::size_t>(roundUp(
+      std::max<std::uint64_t>(end - offset, extentSize), pageSize));
+
+    void* mapping = MAP_FAILED;
+    if (allocate(offset + size))
+    {
+      mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, 
+        handle, static_cast<off_t>(offset));
+    }
+
+    if (mapping != MAP_FAILED)
+    {
+      Window* next = new Window{offset, size, static_cast<char*>(mapping)};
+      Rcu::assign(window, next);
+      if (current)
+      {
+        retired.push_back(RetiredWindow{current, Rcu::startGracePeriod()});
+      }
+      reclaim(false);
+      std::memcpy(next->data + (pos - offset), data.data(), data.size());
+      return;
+    }
+  }
+
+  // behind the window, or the file could not be mapped
+  auto remaining = data.size();
+  const char* source = data.data();
+  while (remaining > 0)
+  {
+    auto written = pwrite(handle, source, remaining, static_cast<off_t>(pos));
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return;
+    }
+    source += written;
+    remaining -= static_cast<std::size_t>(written);
+    pos += static_cast<std::uint64_t>(written);
+  }
+}
+
+void MappedLogFile::reclaim(bool all)
+{
+  auto it = retired.begin();
+  while (it != retired.end())
+  {
+    if (all || Rcu::hasElapsed(it->gracePeriod))
+    {
+      munmap(it->window->data, it->window->size);
+      delete it->window;
+      it = retired.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+bool MappedLogFile::allocate(std::uint64_t size)
+{
+  if (size <= allocated)
+  {
+    return true;
+  }
+
+  auto target = roundUp(size, extentSize);
+  if (posix_fallocate(handle, static_cast<off_t>(allocated), 
+    static_cast<off_t>(target - allocated)) != 0)
+  {
+    return false;
+  }
+  allocated = target;
+  return true;
+}
+
+#else
+
+bool MappedLogFile::open(const std::string& filename, bool append)
+{
+  LU_UNUSED(filename);
+  LU_UNUSED(append);
+  return false;
+}
+
+void MappedLogFile::close()
+{
+}
+
+void MappedLogFile::append(StringRef data)
+{
+  LU_UNUSED(data);
+  assert(isOpen());
+}
+
+void MappedLogFile::appendSlow(std::uint64_t pos, StringRef data)
+{
+  LU_UNUSED(pos);
+  LU_UNUSED(data);
+}
+
+void MappedLogFile::reclaim(bool all)
+{
+  LU_UNUSED(all);
+}
+
+bool MappedLogFile::allocate(std::uint64_t size)
+{
+  LU_UNUSED(size);
+  return false;
+}
+
+#endif
+
+}
@@ -0,0 +1,224 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "log/PatternLogFormatter.h"
+#include "log/LogFormat.h"
+#include <ctime>
+
+namespace util
+{
+
+namespace
+{
+
+/**
+ * The date and time of the last second formatted by the thread.
+ */
+struct TimeCache
+{
+  std::time_t second = -1;
+  char prefix[32];
+  std::size_t length = 0;
+};
+
+TimeCache& getTimeCache()
+{
+  static thread_local TimeCache cache;
+  return cache;
+}
+
+}
+
+const char* const PatternLogFormatter::DEFAULT_PATTERN = 
+  "%time %level [%log] %tag: %msg";
+
+PatternLogFormatter::PatternLogFormatter()
+  : PatternLogFormatter(DEFAULT_PATTERN)
+{
+}
+
+PatternLogFormatter::PatternLogFormatter(const std::string& pattern)
+  : pattern(pattern),
+    pieces()
+{
+  compile();
+}
+
+const std::string& PatternLogFormatter::getPattern() const
+{
+  return pattern;
+}
+
+void PatternLogFormatter::compile()
+{
+  static const struct
+  {
+    StringRef name;
+    PieceType type;
+  } PLACEHOLDERS[] =
+  {
+    { "time", PieceType::Time },
+    { "level", PieceType::Level },
+    { "log", PieceType::LogName },
+    { "tag", PieceType::Tag },
+    { "msg", PieceType::Message },
+    { "file", PieceType::File },
+    { "line", PieceType::Line },
+    { "func", PieceType::Function }
+  };
+
+  std::string literal;
+  std::size_t pos = 0;
+  while (pos < pattern.size())
+  {
+    char c = pattern[pos++];
+    if (c != '%')
+    {
+      literal.push_back(c);
+      continue;
+    }
+
+    if (pos < pattern.size() && pattern[pos] == '%')
+    {
+      literal.push_back('%');
+      pos++;
+      continue;
+    }
+
+    std::size_t end = pos;
+    while (end < pattern.size() && pattern[end] >= 'a' && pattern[end] <= 'z')
+    {
+      end++;
+    }
+    StringRef name(pattern.data() + pos, end - pos);
+
+    bool found = false;
+    for (const auto& placeholder : PLACEHOLDERS)
+    {
+      if (placeholder.name == name)
+      {
+        if (!literal.empty())
+        {
+          pieces.push_back(Piece{PieceType::Literal, literal});
+          literal.clear();
+        }
+        pieces.push_back(Piece{placeholder.type, std::string()});
+        found = true;
+        break;
+      }
+    }
+
+    if (!found)
+    {
+      literal.push_back('%');
+      literal += name;
+    }
+    pos = end;
+  }
+
+  if (!literal.empty())
+  {
+    pieces.push_back(Piece{PieceType::Literal, literal});
+  }
+}
+
+void PatternLogFormatter::append(const LogMessage& msg, std::string& out)
+{
+  for (const auto& piece : pieces)
+  {
+    switch (piece.type)
+    {
+    case PieceType::Literal:
+      out += piece.text;
+      break;
+    case PieceType::Time:
+      appendTime(msg.timeStamp, out);
+      break;
+    case PieceType::Level:
+      out += getLevelName(msg.level);
+      break;
+    case PieceType::LogName:
+      out += msg.logName;
+      break;
+    case PieceType::Tag:
+      out += msg.tag;
+      break;
+    case PieceType::Message:
+      out += msg.message;
+      break;
+    case PieceType::File:
+      if (msg.source.file)
+      {
+        out += msg.source.file;
+      }
+      break;
+    case PieceType::Line:
+      if (msg.source.line > 0)
+      {
+        formatValue(out, msg.source.line);
+      }
+      break;
+    case PieceType::Function:
+      if (msg.source.function)
+      {
+        out += msg.source.function;
+      }
+      break;
+    }
+  }
+}
+
+void PatternLogFormatter::appendTime(
+  std::chrono::system_clock::time_point timeStamp, std::string& out)
+{
+  auto sinceEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(
+    timeStamp.time_since_epoch()).count();
+  auto millis = static_cast<unsigned>(sinceEpoch % 1000);
+  std::time_t second = std::chrono::system_clock::to_time_t(timeStamp);
+
+  auto& cache = getTimeCache();
+  if (cache.second != second)
+  {
+    std::tm local;
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+    localtime_s(&local, &second);
+#else
+    localtime_r(&second, &local);
+#endif
+    cache.length = std::strftime(cache.prefix, sizeof(cache.prefix), 
+      "%Y-%m-%d %H:%M:%S", &local);
+    cache.second = second;
+  }
+
+  char fraction[4] = 
+  {
+    '.',
+    static_cast<char>('0' + millis / 100),
+    static_cast<char>('0' + millis / 10 % 10),
+    static_cast<char>('0' + millis % 10)
+  };
+  out.append(cache.prefix, cache.length);
+  out.append(fraction, sizeof(fraction));
+}
+
+}
@@ -31,9 +31,10 @@ StreamLogWriter::StreamLogWriter(std::ostream& stream)
 {
 }
 
-void StreamLogWriter::output(const std::string& msg)
+void StreamLogWriter::output(StringRef lines)
 {
-  stream << msg << std::endl;
+  stream.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+  stream.flush();
 }
 
 }
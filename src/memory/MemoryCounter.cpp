@@ -0,0 +1,72 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "memory/MemoryCounter.h"
+
+namespace util
+{
+
+/**
+ * Gives the thread's shard back when the thread exits.
+ */
+struct MemoryShard::ShardOwner
+{
+  std::size_t index = NO_SHARD;
+
+  ~ShardOwner();
+};
+
+const std::size_t MemoryShard::NO_SHARD;
+const std::size_t MemoryShard::COUNT;
+const std::size_t MemoryShard::SHARED;
+
+std::atomic<bool> MemoryShard::inUse[COUNT];
+thread_local std::size_t MemoryShard::threadShard = MemoryShard::NO_SHARD;
+thread_local MemoryShard::ShardOwner MemoryShard::shardOwner;
+
+MemoryShard::ShardOwner::~ShardOwner()
+{
+  if (index != NO_SHARD)
+  {
+    // memory freed by later thread exit handlers goes to the shared shard
+    threadShard = SHARED;
+    inUse[index].store(false, std::memory_order_release);
+  }
+}
+
+std::size_t MemoryShard::claimShard()
+{
+  for (std::size_t i = 0; i < SHARED; i++)
+  {
+    bool expected = false;
+    if (!inUse[i].load(std::memory_order_relaxed) && 
+      inUse[i].compare_exchange_strong(expected, true, 
+                                       std::memory_order_acquire))
+    {
+      shardOwner.index = i;
+      return i;
+    }
+  }
+  return SHARED;
+}
+
+}
@@ -0,0 +1,159 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "utility/Rcu.h"
+#include <thread>
+
+namespace util
+{
+
+/**
+ * The state of one thread.  Records are never freed, when a thread exits its 
+ * record is reused by the next thread that needs one.
+ */
+struct Rcu::ThreadRecord
+{
+  char leadPadding[LU_CACHE_LINE_SIZE];
+  /** The global epoch when the thread entered, or zero when outside. */
+  std::atomic<std::uint64_t> epoch;
+  std::atomic<bool> inUse;
+  ThreadRecord* next;
+  unsigned nesting;
+  char trailPadding[LU_CACHE_LINE_SIZE];
+};
+
+/**
+ * Returns the thread's record to the free pool when the thread exits.
+ */
+struct Rcu::RecordOwner
+{
+  ThreadRecord* record = nullptr;
+
+  ~RecordOwner();
+};
+
+std::atomic<Rcu::ThreadRecord*> Rcu::records(nullptr);
+std::atomic<std::uint64_t> Rcu::globalEpoch(1);
+thread_local Rcu::ThreadRecord* Rcu::threadRecord = nullptr;
+thread_local Rcu::RecordOwner Rcu::recordOwner;
+
+Rcu::RecordOwner::~RecordOwner()
+{
+  if (record)
+  {
+    assert(record->nesting == 0);
+    record->epoch.store(0, std::memory_order_release);
+    record->inUse.store(false, std::memory_order_release);
+    threadRecord = nullptr;
+  }
+}
+
+Rcu::ThreadRecord* Rcu::getThreadRecord()
+{
+  if (threadRecord)
+  {
+    return threadRecord;
+  }
+
+  ThreadRecord* record = nullptr;
+  for (auto r = records.load(std::memory_order_acquire); r; r = r->next)
+  {
+    bool expected = false;
+    if (!r->inUse.load(std::memory_order_relaxed) && 
+      r->inUse.compare_exchange_strong(expected, true))
+    {
+      record = r;
+      break;
+    }
+  }
+
+  if (!record)
+  {
+    record = new ThreadRecord();
+    record->epoch.store(0, std::memory_order_relaxed);
+    record->inUse.store(true, std::memory_order_relaxed);
+    record->nesting = 0;
+    record->next = records.load(std::memory_order_relaxed);
+    while (!records.compare_exchange_weak(record->next, record, 
+      std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  recordOwner.record = record;
+  threadRecord = record;
+  return record;
+}
+
+void Rcu::lock()
+{
+  ThreadRecord* record = getThreadRecord();
+  if (record->nesting++ == 0)
+  {
+    record->epoch.store(globalEpoch.load(std::memory_order_relaxed), 
+      std::memory_order_seq_cst);
+  }
+}
+
+void Rcu::unlock()
+{
+  ThreadRecord* record = threadRecord;
+  assert(record && record->nesting > 0);
+  if (--record->nesting == 0)
+  {
+    record->epoch.store(0, std::memory_order_release);
+  }
+}
+
+void Rcu::synchronize()
+{
+  assert(!threadRecord || threadRecord->nesting == 0);
+
+  auto gracePeriod = startGracePeriod();
+  while (!hasElapsed(gracePeriod))
+  {
+    std::this_thread::yield();
+  }
+}
+
+std::uint64_t Rcu::startGracePeriod()
+{
+  // readers that enter after this point see the new epoch, and also any 
+  // pointer published before the call
+  return globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+}
+
+bool Rcu::hasElapsed(std::uint64_t gracePeriod)
+{
+  for (auto r = records.load(std::memory_order_acquire); r; r = r->next)
+  {
+    auto epoch = r->epoch.load(std::memory_order_seq_cst);
+    if (epoch != 0 && epoch < gracePeriod)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
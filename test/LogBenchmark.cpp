@@ -0,0 +1,327 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "LogBenchmark.h"
+#include "log/FileLogWriter.h"
+#include "log/Log.h"
+#include "log/PatternLogFormatter.h"
+#include "log/StreamLogWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace util;
+
+namespace
+{
+
+#if LU_PLATFORM == LU_PLATFORM_WINDOWS
+const char* const NULL_DEVICE = "NUL";
+#else
+const char* const NULL_DEVICE = "/dev/null";
+#endif
+
+/** Calls at a disabled level are timed in groups, being too fast to time. */
+const std::size_t DISABLED_GROUP_SIZE = 1000;
+
+using Clock = std::chrono::steady_clock;
+
+enum class Api
+{
+  String,
+  Printf,
+  Typed,
+  Stream
+};
+
+const char* const API_NAMES[] = { "string", "printf", "typed", "stream" };
+
+enum class Target
+{
+  Null,
+  File,
+  Disabled
+};
+
+const char* const TARGET_NAMES[] = { "null", "file", "disabled" };
+
+struct Options
+{
+  std::size_t maxThreads;
+  std::size_t messages;
+  std::string filename;
+};
+
+/**
+ * Holds the producer threads until all of them are ready.
+ */
+class StartGate
+{
+private:
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::size_t waiting;
+  bool open;
+
+public:
+  StartGate()
+    : mutex(), condition(), waiting(0), open(false)
+  {
+  }
+
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    waiting++;
+    condition.notify_all();
+    condition.wait(lock, [this] { return open; });
+  }
+
+  /**
+   * Waits for the threads to be ready and lets them go.  Returns the time 
+   * just before the gate opened.
+   */
+  Clock::time_point release(std::size_t threads)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&] { return waiting == threads; });
+    auto start = Clock::now();
+    open = true;
+    condition.notify_all();
+    return start;
+  }
+};
+
+void logOnce(Log& log, Api api, std::size_t i)
+{
+  switch (api)
+  {
+  case Api::String:
+    log.info("bench", "a benchmark message of a typical length");
+    break;
+
+  case Api::Printf:
+    log.infof("bench", "benchmark message %u from %s", 
+      static_cast<unsigned>(i), "printf");
+    break;
+
+  case Api::Typed:
+    log.infof("bench", LU_FMT("benchmark message {} from {}"), i, "typed");
+    break;
+
+  case Api::Stream:
+    log.info("bench") << "benchmark message " << i << " from stream";
+    break;
+  }
+}
+
+/**
+ * Logs the messages of one thread, storing the time each call took.  At a 
+ * disabled level each sample is the average of a group of calls.
+ */
+void produce(Log& log, Api api, Target target, std::size_t messages, 
+  StartGate& gate, std::vector<double>& samples)
+{
+  std::size_t group = target == Target::Disabled ? DISABLED_GROUP_SIZE : 1;
+  samples.clear();
+  samples.reserve(messages / group);
+  gate.wait();
+
+  for (std::size_t i = 0; i + group <= messages; i += group)
+  {
+    auto start = Clock::now();
+    for (std::size_t j = 0; j < group; j++)
+    {
+      logOnce(log, api, i + j);
+    }
+    auto elapsed = Clock::now() - start;
+    samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() 
+      / static_cast<double>(group));
+  }
+}
+
+double getPercentile(const std::vector<double>& sorted, 
+  double percentile)
+{
+  if (sorted.empty())
+  {
+    return 0;
+  }
+  auto index = static_cast<std::size_t>(percentile / 100.0 * 
+    static_cast<double>(sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+void run(const Options& options, Api api, Target target, std::size_t threads)
+{
+  Log log("bench");
+  std::ofstream nullStream;
+
+  // the writers are not thread safe, so concurrent producers go through the 
+  // queue of an asynchronous log
+  bool async = threads > 1 && target != Target::Disabled;
+  auto formatter = std::make_shared<PatternLogFormatter>();
+
+  switch (target)
+  {
+  case Target::Null:
+  case Target::Disabled:
+    {
+      nullStream.open(NULL_DEVICE);
+      auto writer = std::make_shared<StreamLogWriter>(nullStream);
+      writer->setFormatter(formatter);
+      log.addWriter("null", writer);
+      if (target == Target::Disabled)
+      {
+        log.setLevel(LogLevel::Warning);
+      }
+    }
+    break;
+
+  case Target::File:
+    {
+      auto writer = std::make_shared<FileLogWriter>(options.filename);
+      writer->setFormatter(formatter);
+      log.addWriter("file", writer);
+    }
+    break;
+  }
+  if (async)
+  {
+    log.enableAsync();
+  }
+
+  StartGate gate;
+  std::vector<std::vector<double>> samples(threads);
+  std::vector<std::thread> producers;
+  for (std::size_t i = 0; i < threads; i++)
+  {
+    producers.emplace_back(&produce, std::ref(log), api, target, 
+      options.messages, std::ref(gate), std::ref(samples[i]));
+  }
+
+  auto start = gate.release(threads);
+  for (auto& producer : producers)
+  {
+    producer.join();
+  }
+  log.flush();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<double> all;
+  for (auto& threadSamples : samples)
+  {
+    all.insert(all.end(), threadSamples.begin(), threadSamples.end());
+  }
+  std::sort(all.begin(), all.end());
+
+  double total = static_cast<double>(options.messages * threads);
+  std::printf("{\"api\":\"%s\",\"writer\":\"%s\",\"mode\":\"%s\","
+    "\"threads\":%u,"
+    "\"messages\":%.0f,\"seconds\":%.6f,\"messages_per_second\":%.0f,"
+    "\"p50_ns\":%.1f,\"p99_ns\":%.1f,\"p99_9_ns\":%.1f,\"max_ns\":%.1f}\n",
+    API_NAMES[static_cast<int>(api)], 
+    TARGET_NAMES[static_cast<int>(target)], async ? "async" : "sync", 
+    static_cast<unsigned>(threads), total, seconds, 
+    seconds > 0 ? total / seconds : 0.0, 
+    getPercentile(all, 50), getPercentile(all, 99), getPercentile(all, 99.9), 
+    all.empty() ? 0.0 : all.back());
+  std::fflush(stdout);
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+  for (int i = 0; i < argc; i += 2)
+  {
+    if (i + 1 == argc)
+    {
+      return false;
+    }
+
+    const char* name = argv[i];
+    const char* value = argv[i + 1];
+    if (std::strcmp(name, "--threads") == 0)
+    {
+      options.maxThreads = std::strtoul(value, nullptr, 10);
+    }
+    else if (std::strcmp(name, "--messages") == 0)
+    {
+      options.messages = std::strtoul(value, nullptr, 10);
+    }
+    else if (std::strcmp(name, "--file") == 0)
+    {
+      options.filename = value;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return options.maxThreads > 0 && options.messages > 0;
+}
+
+}
+
+int runLogBenchmark(int argc, char* argv[])
+{
+  Options options{
+    std::max(1u, std::thread::hardware_concurrency()),
+    100000,
+    "log_benchmark.log"
+  };
+  if (!parseOptions(argc, argv, options))
+  {
+    std::fprintf(stderr, "usage: --benchmark [--threads N] [--messages N] "
+      "[--file PATH]\n");
+    return 1;
+  }
+
+  // 1, 2, 4, ... threads, always ending with the maximum
+  std::vector<std::size_t> threadCounts;
+  for (std::size_t threads = 1; threads < options.maxThreads; threads *= 2)
+  {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(options.maxThreads);
+
+  const Api apis[] = { Api::String, Api::Printf, Api::Typed, Api::Stream };
+  const Target targets[] = { Target::Null, Target::File, Target::Disabled };
+  for (Target target : targets)
+  {
+    for (Api api : apis)
+    {
+      for (std::size_t threads : threadCounts)
+      {
+        run(options, api, target, threads);
+        std::remove(options.filename.c_str());
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,43 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef LOGBENCHMARK_H_INCLUDED__
+#define LOGBENCHMARK_H_INCLUDED__
+
+/**
+ * Measures the throughput and per-call latency of Log for each API style 
+ * and writer, with 1 to N producer threads, plus the cost of a call at a 
+ * disabled level.  Runs with more than one thread use an asynchronous log, 
+ * since the writers are not thread safe, and include the time taken to 
+ * drain its queue.  Each result is printed to stdout as one JSON object per 
+ * line, so runs can be compared between versions.  The options are:
+ * 
+ *  - --threads N   the largest number of producer threads, by default the 
+ *                  number of hardware threads
+ *  - --messages N  the number of messages logged by each thread
+ *  - --file PATH   the file used by the FileLogWriter runs
+ * 
+ * \return The exit code of the program.
+ */
+int runLogBenchmark(int argc, char* argv[]);
+
+#endif
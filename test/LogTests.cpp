@@ -0,0 +1,501 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "LogTests.h"
+#include "TestResult.h"
+#include "log/AsyncLogQueue.h"
+#include "log/BinaryLog.h"
+#include "log/BinaryLogDecoder.h"
+#include "log/FileLogWriter.h"
+#include "log/Log.h"
+#include "log/PatternLogFormatter.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace util;
+
+namespace
+{
+
+/** Counts every allocation made through the global operator new. */
+std::atomic<std::size_t> allocationCount(0);
+
+}
+
+// the replacements count allocations made anywhere in the program
+void* operator new(std::size_t size)
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size != 0 ? size : 1);
+  if (!ptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* ptr) throw()
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+  std::free(ptr);
+}
+
+// sized deallocation is used from C++14 on
+void operator delete(void* ptr, std::size_t size) throw()
+{
+  LU_UNUSED(size);
+  operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t size) throw()
+{
+  LU_UNUSED(size);
+  operator delete[](ptr);
+}
+
+namespace
+{
+
+/**
+ * Logs call sites sharing one format literal with different argument types, 
+ * and checks that each record decodes with its own types.
+ */
+bool testBinaryLogRoundTrip()
+{
+  TestResult result("BinaryLog round trip");
+  std::stringstream stream;
+  {
+    BinaryLog log("binary", stream);
+    log.log(LogLevel::Info, "test", LU_FMT("value {}"), 42);
+    log.log(LogLevel::Info, "test", LU_FMT("value {}"), "hello");
+    log.log(LogLevel::Info, "test", LU_FMT("value {}"), 2.5);
+    log.log(LogLevel::Warning, "test", LU_FMT("{} and {}"), 
+      static_cast<std::uint64_t>(7), true);
+    log.flush();
+  }
+
+  std::vector<std::string> messages;
+  std::vector<LogLevel> levels;
+  BinaryLogDecoder decoder;
+  bool decoded = decoder.decode(stream, [&](const LogMessage& message)
+  {
+    messages.push_back(message.message.str());
+    levels.push_back(message.level);
+  });
+
+  result.check(decoded, "decode failed: " + decoder.getError());
+  const char* const expected[] = { 
+    "value 42", "value hello", "value 2.5", "7 and true" 
+  };
+  result.check(messages.size() == 4, "expected 4 messages, got " + 
+    std::to_string(messages.size()));
+  for (std::size_t i = 0; i < messages.size() && i < 4; i++)
+  {
+    result.check(messages[i] == expected[i], "expected \"" + 
+      std::string(expected[i]) + "\", got \"" + messages[i] + "\"");
+  }
+  result.check(levels.size() == 4 && levels[3] == LogLevel::Warning, 
+    "the level of the last message was not kept");
+  return result.report();
+}
+
+/**
+ * Keeps all output in a string with enough capacity reserved up front.
+ */
+class StringLogWriter final
+  : public LogWriter
+{
+private:
+  std::string text;
+
+public:
+  StringLogWriter()
+    : text()
+  {
+    text.reserve(1 << 20);
+  }
+
+  void clear()
+  {
+    text.clear();
+  }
+
+  const std::string& getText() const
+  {
+    return text;
+  }
+
+protected:
+  virtual void output(StringRef lines) override
+  {
+    text.append(lines.data(), lines.size());
+  }
+};
+
+/**
+ * Logs a few messages of each style and returns the number of allocations 
+ * they made.
+ */
+std::size_t countDispatchAllocations(Log& log, StringLogWriter& writer)
+{
+  writer.clear();
+  auto before = allocationCount.load();
+  for (int i = 0; i < 100; i++)
+  {
+    log.info("test", "a message");
+    log.infof("test", "message %d", i);
+    log.infof("test", LU_FMT("message {} of {}"), i, "typed");
+  }
+  log.flush();
+  return allocationCount.load() - before;
+}
+
+/**
+ * Checks that once a log has warmed up, dispatching a message allocates 
+ * nothing, in both synchronous and asynchronous mode.
+ */
+bool testSteadyStateAllocations()
+{
+  TestResult result("Log steady state allocations");
+  Log log("alloc");
+  auto writer = std::make_shared<StringLogWriter>();
+  writer->setFormatter(std::make_shared<PatternLogFormatter>());
+  log.addWriter("string", writer);
+
+  countDispatchAllocations(log, *writer);
+  auto count = countDispatchAllocations(log, *writer);
+  result.check(count == 0, "synchronous dispatch made " + 
+    std::to_string(count) + " allocations");
+
+  // each slot of the queue grows on first use, so the warm up must go 
+  // around the queue
+  log.enableAsync(64);
+  countDispatchAllocations(log, *writer);
+  count = countDispatchAllocations(log, *writer);
+  result.check(count == 0, "asynchronous dispatch made " + 
+    std::to_string(count) + " allocations");
+  log.disableAsync();
+  return result.report();
+}
+
+/**
+ * Has several threads push into a small blocking queue, each checking after 
+ * every flush that all of its own messages have reached the sink.
+ */
+bool testAsyncFlush()
+{
+  TestResult result("AsyncLogQueue flush");
+  const int THREADS = 4;
+  const int MESSAGES = 5000;
+  std::mutex mutex;
+  std::vector<int> received(THREADS, 0);
+  std::atomic<int> failures(0);
+  {
+    AsyncLogQueue queue(8, LogOverflowPolicy::Block, 
+      [&](const LogMessage* const* batch, std::size_t count)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (std::size_t i = 0; i < count; i++)
+      {
+        received[batch[i]->message.data()[0] - '0']++;
+      }
+    });
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++)
+    {
+      threads.emplace_back([&, t]
+      {
+        char id = static_cast<char>('0' + t);
+        for (int i = 1; i <= MESSAGES; i++)
+        {
+          queue.push(LogLevel::Info, std::chrono::system_clock::now(), 
+            "flush", "", StringRef(&id, 1), LogSource(), LogFields());
+          if (i % 50 == 0)
+          {
+            queue.flush();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (received[t] != i)
+            {
+              failures++;
+            }
+          }
+        }
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  result.check(failures == 0, std::to_string(failures.load()) + 
+    " flushes returned before the messages logged ahead of them were written");
+  for (int t = 0; t < THREADS; t++)
+  {
+    result.check(received[t] == MESSAGES, "thread " + std::to_string(t) + 
+      " delivered " + std::to_string(received[t]) + " messages");
+  }
+  return result.report();
+}
+
+/**
+ * Holds the background thread in the sink with one message claimed, and 
+ * checks that pushes to a full DropOldest queue discard the new message 
+ * instead of waiting for the sink.
+ */
+bool testDropOldestWhileDraining()
+{
+  TestResult result("AsyncLogQueue DropOldest while draining");
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool entered = false;
+  bool released = false;
+  std::size_t received = 0;
+
+  AsyncLogQueue queue(8, LogOverflowPolicy::DropOldest, 
+    [&](const LogMessage* const*, std::size_t count)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    entered = true;
+    condition.notify_all();
+    condition.wait(lock, [&] { return released; });
+    received += count;
+  });
+
+  auto push = [&queue]
+  {
+    return queue.push(LogLevel::Info, std::chrono::system_clock::now(), 
+      "drop", "", "message", LogSource(), LogFields());
+  };
+
+  push();
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&] { return entered; });
+  }
+  int accepted = 0;
+  for (int i = 0; i < 20; i++)
+  {
+    accepted += push() ? 1 : 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+    condition.notify_all();
+  }
+  queue.flush();
+
+  result.check(accepted == 7, "accepted " + std::to_string(accepted) + 
+    " messages, expected 7");
+  result.check(queue.getDroppedNewest() == 13, "dropped " + 
+    std::to_string(queue.getDroppedNewest()) + " new messages, expected 13");
+  result.check(queue.getDroppedOldest() == 0, "dropped " + 
+    std::to_string(queue.getDroppedOldest()) + " old messages, expected 0");
+  result.check(received == 8, "received " + std::to_string(received) + 
+    " messages, expected 8");
+  return result.report();
+}
+
+/**
+ * Leaves segments from an earlier run next to a log file, and checks that 
+ * rotation keeps only the newest of all segments.
+ */
+bool testRotationRetention()
+{
+  TestResult result("FileLogWriter rotation retention");
+  const std::string filename = "rotation_test.log";
+  const char* const earlier[] = {
+    "rotation_test.log.20140301-120000.gz",
+    "rotation_test.log.20140301-120000-1",
+    "rotation_test.log.20140302-080000"
+  };
+  const std::string unrelated = "rotation_test.log.backup";
+  for (const char* name : earlier)
+  {
+    std::ofstream(name) << "earlier run\n";
+  }
+  std::ofstream(unrelated) << "not a segment\n";
+
+  {
+    FileLogWriter writer(filename, false, FileLogMode::Buffered);
+    writer.setRotation(FileLogRotation{0, std::chrono::seconds(0), 2, false});
+    result.check(writer.rotate(), "rotate failed");
+  }
+
+  auto segments = LogArchiver::findSegments(filename);
+  result.check(segments.size() == 2, "expected 2 segments, found " + 
+    std::to_string(segments.size()));
+  result.check(!segments.empty() && segments.front() == earlier[2], 
+    "the newest earlier segment was not kept");
+  result.check(std::ifstream(unrelated).is_open(), 
+    "an unrelated file was deleted");
+
+  for (const std::string& segment : segments)
+  {
+    std::remove(segment.c_str());
+  }
+  std::remove(unrelated.c_str());
+  std::remove(filename.c_str());
+  return result.report();
+}
+
+/**
+ * Checks that a run of repeats is summarized once its window has passed, 
+ * without waiting for a different message, and when the log is destroyed.
+ */
+bool testRepeatSummaries()
+{
+  TestResult result("LogWriter repeat summaries");
+  const std::string summary = "Last message repeated 2 times";
+  auto writer = std::make_shared<StringLogWriter>();
+  writer->setFormatter(std::make_shared<PatternLogFormatter>());
+  {
+    Log log("repeats");
+    log.addWriter("string", writer);
+
+    writer->setCoalescing(true, std::chrono::milliseconds(1));
+    for (int i = 0; i < 3; i++)
+    {
+      log.info("test", "repeated");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    log.flush();
+    result.check(writer->getText().find(summary) != std::string::npos, 
+      "no summary after the window passed");
+
+    writer->clear();
+    writer->setCoalescing(true, std::chrono::hours(1));
+    for (int i = 0; i < 3; i++)
+    {
+      log.info("test", "repeated");
+    }
+    log.flush();
+    result.check(writer->getText().find(summary) == std::string::npos, 
+      "summary written before the window passed");
+  }
+  result.check(writer->getText().find(summary) != std::string::npos, 
+    "no summary when the log was destroyed");
+  return result.report();
+}
+
+/**
+ * Writes only the message text, and counts the messages formatted.
+ */
+class CountingLogFormatter final
+  : public ILogFormatter
+{
+private:
+  std::size_t count;
+
+public:
+  CountingLogFormatter()
+    : count(0)
+  {
+  }
+
+  std::size_t getCount() const
+  {
+    return count;
+  }
+
+  virtual void append(const LogMessage& msg, std::string& out) override
+  {
+    count++;
+    out.append(msg.message.data(), msg.message.size());
+  }
+};
+
+/**
+ * Checks that writers sharing a formatter have each message formatted at 
+ * most once, and only if one of them writes its level.
+ */
+bool testSharedFormatterLevels()
+{
+  TestResult result("LogFormatCache levels");
+  auto formatter = std::make_shared<CountingLogFormatter>();
+  auto warnings = std::make_shared<StringLogWriter>();
+  auto errors = std::make_shared<StringLogWriter>();
+  warnings->setFormatter(formatter);
+  warnings->setLevel(LogLevel::Warning);
+  errors->setFormatter(formatter);
+  errors->setLevel(LogLevel::Error);
+
+  Log log("levels");
+  log.addWriter("warnings", warnings);
+  log.addWriter("errors", errors);
+  log.info("test", "info");
+  log.warning("test", "warning");
+  log.error("test", "error");
+
+  result.check(formatter->getCount() == 2, "formatted " + 
+    std::to_string(formatter->getCount()) + " messages, expected 2");
+  result.check(warnings->getText() == "warning\nerror\n", 
+    "warning writer wrote \"" + warnings->getText() + "\"");
+  result.check(errors->getText() == "error\n", 
+    "error writer wrote \"" + errors->getText() + "\"");
+  return result.report();
+}
+
+}
+
+int runLogTests()
+{
+  bool (*const tests[])() = {
+    testBinaryLogRoundTrip,
+    testSteadyStateAllocations,
+    testAsyncFlush,
+    testDropOldestWhileDraining,
+    testRotationRetention,
+    testRepeatSummaries,
+    testSharedFormatterLevels
+  };
+
+  int failed = 0;
+  for (auto test : tests)
+  {
+    if (!test())
+    {
+      failed++;
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,414 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include "MemoryTests.h"
+#include "TestResult.h"
+#include "memory/ArenaAllocator.h"
+#include "memory/MemoryAllocator.h"
+#include "memory/MemoryArena.h"
+#include "memory/PoolAllocator.h"
+#include "memory/StatefulStdLibAllocator.h"
+#include "memory/StdLibAllocator.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <map>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace util;
+
+// the tests check the counters, which are empty when tracking is disabled
+#if !defined(LU_DISABLE_MEMORY_TRACK)
+namespace
+{
+
+// a System of its own for each test, so the counters start at zero
+struct ReallocTestSystem {};
+struct UnsizedFreeTestSystem {};
+struct PoolSpillTestSystem {};
+struct PoolLimitTestSystem {};
+struct ArenaScopeTestSystem {};
+struct ArenaReallocTestSystem {};
+struct StatefulTestSystem {};
+
+/**
+ * Checks that the current and peak bytes account for every size exactly.  
+ * With detailed tracking a block moved by realloc is freed through the 
+ * unsized free, which the header makes exact; otherwise the blocks are 
+ * freed with their sizes.  The blocks are larger than PEAK_BATCH so that the 
+ * peak is folded in at once.
+ */
+bool testAllocatorUsage()
+{
+  TestResult result("MemoryAllocator usage");
+  using Allocator = MemoryAllocator<ReallocTestSystem>;
+  const std::size_t SMALL = 100 * 1024;
+  const std::size_t LARGE = 200 * 1024;
+  const std::size_t TOO_LARGE = std::numeric_limits<std::size_t>::max() / 2 + 1;
+
+  result.check(Allocator::malloc(TOO_LARGE, 2) == nullptr, 
+    "array size overflow");
+  void* ptr = Allocator::malloc(SMALL);
+#if defined(LU_DEBUG_MEMORY_TRACK_DETAIL)
+  const std::size_t PEAK = LARGE;
+  ptr = Allocator::realloc(ptr, LARGE);
+  result.check(ptr != nullptr, "realloc failed");
+  MemoryUsage usage = Allocator::Counter::getUsage();
+  result.check(usage.currentBytes == LARGE, "current bytes after realloc " + 
+    std::to_string(usage.currentBytes));
+  Allocator::free(ptr);
+#else
+  const std::size_t PEAK = SMALL + LARGE;
+  void* other = Allocator::malloc(LARGE);
+  result.check(ptr != nullptr && other != nullptr, "malloc failed");
+  MemoryUsage usage = Allocator::Counter::getUsage();
+  result.check(usage.currentBytes == PEAK, "current bytes after malloc " + 
+    std::to_string(usage.currentBytes));
+  Allocator::free(ptr, SMALL);
+  Allocator::free(other, LARGE);
+#endif
+
+  usage = Allocator::Counter::getUsage();
+  result.check(usage.bytesKnown, "bytes reported as unknown");
+  result.check(usage.currentAllocs == 0, "current allocs " + 
+    std::to_string(usage.currentAllocs));
+  result.check(usage.currentBytes == 0, "current bytes " + 
+    std::to_string(usage.currentBytes));
+  result.check(usage.peakBytes == PEAK, "peak bytes " + 
+    std::to_string(usage.peakBytes));
+  return result.report();
+}
+
+/**
+ * Checks that the byte counts are reported as unknown once a free has been 
+ * tracked without its size.
+ */
+bool testUnsizedFree()
+{
+  TestResult result("MemoryCounter unsized free");
+  using Counter = MemoryCounter<UnsizedFreeTestSystem>;
+  int block = 0;
+
+  Counter::trackAlloc(&block, sizeof(block));
+  Counter::trackFree(&block);
+  MemoryUsage usage = Counter::getUsage();
+  result.check(!usage.bytesKnown, "bytes reported as known");
+  result.check(usage.currentBytes == 0 && usage.peakBytes == 0, 
+    "unknown bytes reported as " + std::to_string(usage.currentBytes) + 
+    " current, " + std::to_string(usage.peakBytes) + " peak");
+  result.check(usage.totalFrees == 1, "total frees " + 
+    std::to_string(usage.totalFrees));
+  return result.report();
+}
+
+/**
+ * Allocates blocks on one thread and frees them on another, then checks that 
+ * a third thread gets every block of the first slab back through the global 
+ * stack, including the unused part of the slab that the first thread 
+ * released when it exited.  The threads run one after another so that the 
+ * blocks held by each cache are known.
+ */
+bool testPoolSpill()
+{
+  TestResult result("PoolAllocator cross-thread spill");
+  using Pool = PoolAllocator<PoolSpillTestSystem, 64, 8>;
+  const std::size_t COUNT = 4 * Pool::BATCH_SIZE;
+  std::vector<void*> blocks(COUNT);
+
+  std::thread([&blocks]()
+  {
+    for (std::size_t i = 0; i < blocks.size(); i++)
+    {
+      blocks[i] = Pool::malloc(64);
+      if (blocks[i])
+      {
+        std::memset(blocks[i], static_cast<int>(i & 0xff), 64);
+      }
+    }
+  }).join();
+  result.check(std::find(blocks.begin(), blocks.end(), nullptr) == 
+    blocks.end(), "malloc failed");
+
+  bool intact = true;
+  std::thread([&blocks, &intact]()
+  {
+    for (std::size_t i = 0; i < blocks.size(); i++)
+    {
+      const unsigned char* bytes = static_cast<unsigned char*>(blocks[i]);
+      intact = intact && bytes[0] == (i & 0xff) && bytes[63] == (i & 0xff);
+      Pool::free(blocks[i]);
+    }
+  }).join();
+  result.check(intact, "blocks changed before they were freed");
+
+  std::size_t slabsBefore = 0;
+  std::size_t slabsAfter = 0;
+  std::thread([&blocks, &slabsBefore, &slabsAfter]()
+  {
+    blocks.resize(Pool::SLAB_BLOCKS);
+    for (auto& block : blocks)
+    {
+      block = Pool::malloc(64);
+    }
+    slabsBefore = Pool::Counter::getUsage().totalAllocs;
+    void* extra = Pool::malloc(64);
+    slabsAfter = Pool::Counter::getUsage().totalAllocs;
+    Pool::free(extra);
+    for (auto block : blocks)
+    {
+      Pool::free(block);
+    }
+  }).join();
+
+  std::sort(blocks.begin(), blocks.end());
+  result.check(std::adjacent_find(blocks.begin(), blocks.end()) == 
+    blocks.end(), "a block was handed out twice");
+  result.check(slabsBefore == 1, "slabs allocated for the first slab's "
+    "blocks " + std::to_string(slabsBefore));
+  result.check(slabsAfter == 2, "slabs allocated once the first was used " + 
+    std::to_string(slabsAfter));
+  return result.report();
+}
+
+/**
+ * Checks that requests larger than the block size fail, and that containers 
+ * see the failure as std::bad_alloc while node based ones work.
+ */
+bool testPoolLimit()
+{
+  TestResult result("PoolAllocator block size limit");
+  using Pool = PoolAllocator<PoolLimitTestSystem, 64, 8>;
+
+  result.check(Pool::malloc(65) == nullptr, "malloc above the block size");
+  result.check(Pool::malloc(32, 3) == nullptr, "array above the block size");
+  const std::size_t huge = std::numeric_limits<std::size_t>::max() / 2 + 1;
+  result.check(Pool::malloc(huge, 2) == nullptr, "array size overflow");
+  void* ptr = Pool::malloc(64);
+  result.check(ptr != nullptr, "malloc at the block size failed");
+  result.check(Pool::realloc(ptr, 64) == ptr, "realloc within the block");
+  result.check(Pool::realloc(ptr, 65) == nullptr, 
+    "realloc above the block size");
+  Pool::free(ptr);
+
+  std::vector<int, StdLibAllocator<int, Pool>> vector;
+  bool thrown = false;
+  try
+  {
+    vector.reserve(64);
+  }
+  catch (const std::bad_alloc&)
+  {
+    thrown = true;
+  }
+  result.check(thrown, "vector above the block size did not throw");
+
+  std::list<int, StdLibAllocator<int, Pool>> list;
+  for (int i = 0; i < 1000; i++)
+  {
+    list.push_back(i);
+  }
+  int expected = 0;
+  bool ordered = true;
+  for (int value : list)
+  {
+    ordered = ordered && value == expected++;
+  }
+  result.check(ordered && expected == 1000, "list contents");
+  return result.report();
+}
+
+/**
+ * Nests scopes on one arena and checks that each frees only what was 
+ * allocated inside it, that the chunks are reused afterwards, and that a 
+ * vector can grow on the current arena through ArenaAllocator.
+ */
+bool testArenaScopes()
+{
+  TestResult result("MemoryArena scopes");
+  using Arena = MemoryArena<ArenaScopeTestSystem>;
+  {
+    Arena arena(1024);
+    void* outside = arena.malloc(100);
+    void* outerFirst = nullptr;
+    void* innerFirst = nullptr;
+    std::size_t reserved = 0;
+    {
+      Arena::Scope outer(arena);
+      outerFirst = arena.malloc(100);
+      {
+        Arena::Scope inner(arena);
+        innerFirst = arena.malloc(100);
+        // too large for the first chunk
+        arena.malloc(2000);
+        reserved = arena.getReservedBytes();
+      }
+      result.check(arena.malloc(100) == innerFirst, 
+        "inner scope was not rewound");
+      result.check(arena.malloc(2000) != nullptr, "malloc after rewind");
+      result.check(arena.getReservedBytes() == reserved, 
+        "chunks were not reused after rewind");
+      result.check(Arena::getCurrent() == &arena, "outer scope not current");
+
+      std::vector<int, StdLibAllocator<int, ArenaAllocator<
+        ArenaScopeTestSystem>>> vector;
+      for (int i = 0; i < 1000; i++)
+      {
+        vector.push_back(i);
+      }
+      result.check(vector.size() == 1000 && vector[999] == 999, 
+        "vector contents");
+    }
+    result.check(Arena::getCurrent() == nullptr, "scope still current");
+    result.check(arena.malloc(100) == outerFirst, 
+      "outer scope was not rewound");
+    result.check(outside != nullptr, "malloc failed");
+  }
+  MemoryUsage usage = Arena::Counter::getUsage();
+  result.check(usage.currentAllocs == 0, "chunks left after destruction " + 
+    std::to_string(usage.currentAllocs));
+  return result.report();
+}
+
+/**
+ * Grows the most recent allocation in place and then past the end of its 
+ * chunk, and checks that the contents move with it.
+ */
+bool testArenaRealloc()
+{
+  TestResult result("MemoryArena realloc");
+  MemoryArena<ArenaReallocTestSystem> arena(1024);
+
+  void* older = arena.malloc(16);
+  char* block = static_cast<char*>(arena.malloc(16));
+  std::memcpy(block, "arena contents", 15);
+  result.check(arena.realloc(older, 32) == nullptr, 
+    "realloc of an older block");
+
+  char* grown = static_cast<char*>(arena.realloc(block, 512));
+  result.check(grown == block, "realloc within the chunk moved the block");
+  char* moved = static_cast<char*>(arena.realloc(grown, 4096));
+  result.check(moved != nullptr && moved != grown, 
+    "realloc past the chunk did not move the block");
+  result.check(moved && std::strcmp(moved, "arena contents") == 0, 
+    "contents lost by realloc");
+  result.check(arena.realloc(moved, 8192) != nullptr, 
+    "realloc of the moved block");
+
+  const std::size_t reserved = arena.getReservedBytes();
+  arena.reset();
+  result.check(arena.malloc(16) == older, "reset did not free everything");
+  result.check(arena.getReservedBytes() == reserved, 
+    "reset released chunks");
+  return result.report();
+}
+
+/**
+ * Binds node based containers to two arenas, and checks that rebound 
+ * allocators compare equal to the original and that copies and assignments 
+ * keep each container on its own arena.
+ */
+bool testStatefulAllocator()
+{
+  TestResult result("StatefulStdLibAllocator instances");
+  using Arena = MemoryArena<StatefulTestSystem>;
+  using IntAllocator = StatefulStdLibAllocator<int, Arena>;
+  using List = std::list<int, IntAllocator>;
+  using Map = std::map<int, int, std::less<int>, 
+    StatefulStdLibAllocator<std::pair<const int, int>, Arena>>;
+  Arena first(1024);
+  Arena second(1024);
+
+  IntAllocator firstAllocator(first);
+  IntAllocator secondAllocator(second);
+  StatefulStdLibAllocator<double, Arena> rebound(firstAllocator);
+  result.check(rebound == firstAllocator, "rebound allocator not equal");
+  result.check(&rebound.getAllocator() == &first, 
+    "rebound allocator uses another arena");
+  result.check(firstAllocator != secondAllocator, 
+    "allocators for different arenas are equal");
+
+  List list(firstAllocator);
+  for (int i = 0; i < 100; i++)
+  {
+    list.push_back(i);
+  }
+  result.check(first.getReservedBytes() != 0 && 
+    second.getReservedBytes() == 0, "list allocated from the wrong arena");
+
+  List copy(list);
+  result.check(copy.get_allocator() == firstAllocator, 
+    "copy constructed list uses another arena");
+
+  List assigned(secondAllocator);
+  assigned = list;
+  result.check(assigned.get_allocator() == secondAllocator, 
+    "copy assignment moved the list to another arena");
+  result.check(second.getReservedBytes() != 0, 
+    "copy assignment did not allocate from the target's arena");
+  result.check(assigned == list, "copy assigned contents");
+
+  assigned = std::move(copy);
+  result.check(assigned.get_allocator() == secondAllocator, 
+    "move assignment moved the list to another arena");
+  result.check(assigned == list, "move assigned contents");
+
+  Map map{std::less<int>(), Map::allocator_type(second)};
+  for (int i = 0; i < 100; i++)
+  {
+    map[i] = i * i;
+  }
+  result.check(map.get_allocator() == secondAllocator, 
+    "map uses another arena");
+  result.check(map.size() == 100 && map[99] == 99 * 99, "map contents");
+  return result.report();
+}
+
+}
+#endif
+
+int runMemoryTests()
+{
+  int failed = 0;
+#if !defined(LU_DISABLE_MEMORY_TRACK)
+  bool (*const tests[])() = {
+    testAllocatorUsage,
+    testUnsizedFree,
+    testPoolSpill,
+    testPoolLimit,
+    testArenaScopes,
+    testArenaRealloc,
+    testStatefulAllocator
+  };
+
+  for (auto test : tests)
+  {
+    if (!test())
+    {
+      failed++;
+    }
+  }
+#endif
+  return failed;
+}
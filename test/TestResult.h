@@ -0,0 +1,64 @@
+/* The MIT License (MIT)
+*
+* Copyright (c) 2014 Michael Crawford
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef TESTRESULT_H_INCLUDED__
+#define TESTRESULT_H_INCLUDED__
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Collects the failures of one test.
+ */
+class TestResult
+{
+private:
+  const char* name;
+  std::vector<std::string> failures;
+
+public:
+  explicit TestResult(const char* name)
+    : name(name), failures()
+  {
+  }
+
+  void check(bool condition, const std::string& description)
+  {
+    if (!condition)
+    {
+      failures.push_back(description);
+    }
+  }
+
+  bool report() const
+  {
+    std::printf("%s %s\n", failures.empty() ? "PASS" : "FAIL", name);
+    for (auto& failure : failures)
+    {
+      std::printf("  %s\n", failure.c_str());
+    }
+    return failures.empty();
+  }
+};
+
+#endif
@@ -1,4 +1,14 @@
+#include "LogBenchmark.h"
+#include "LogTests.h"
+#include "MemoryTests.h"
+#include <cstring>
+
 int main(int argc, char* argv[])
 {
-  return 0;
-}
\ No newline at end of file
+  if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+  {
+    return runLogBenchmark(argc - 2, argv + 2);
+  }
+  int failed = runLogTests() + runMemoryTests();
+  return failed == 0 ? 0 : 1;
+}